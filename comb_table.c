@@ -0,0 +1,123 @@
+#include "comb_table.h"
+#include "lexer_munch.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 只在最近放好的这么多行里挑默认状态，构造时间与状态数保持线性
+#define COMB_DEFAULT_WINDOW 32
+
+static void grow_comb_table(struct CombTable* t, int* cap, int need) {
+    if (need <= *cap) return;
+    int new_cap = *cap;
+    while (new_cap < need) new_cap *= 2;
+    t->next = realloc(t->next, new_cap * sizeof(int));
+    t->check = realloc(t->check, new_cap * sizeof(int));
+    for (int i = *cap; i < new_cap; i++) t->check[i] = -1;
+    *cap = new_cap;
+}
+
+struct CombTable* build_comb_table(struct DFATable* dense) {
+    int n = dense->num_states;
+    struct CombTable* t = malloc(sizeof(struct CombTable));
+    t->num_states = n;
+    t->base = malloc((n + 1) * sizeof(int));
+    t->default_state = malloc((n + 1) * sizeof(int));
+    t->accept = malloc((n + 1) * sizeof(int));
+    memcpy(t->accept, dense->accept, n * sizeof(int));
+    int cap = 1024;
+    t->next = malloc(cap * sizeof(int));
+    t->check = malloc(cap * sizeof(int));
+    for (int i = 0; i < cap; i++) t->check[i] = -1;
+    t->size = 0;
+
+    int cols[256];
+    int first_free = 0;
+    for (int s = 0; s < n; s++) {
+        const int* row = dense->next + (size_t)s * 256;
+        // 默认状态：差异列最少的已放置行；不如直接存全部非死列时不用
+        int best = -1, best_diff = 0;
+        for (int c = 0; c < 256; c++) best_diff += row[c] != -1;
+        for (int d = s - 1; d >= 0 && d >= s - COMB_DEFAULT_WINDOW; d--) {
+            const int* drow = dense->next + (size_t)d * 256;
+            int diff = 0;
+            for (int c = 0; c < 256 && diff < best_diff; c++) diff += row[c] != drow[c];
+            if (diff < best_diff) {
+                best = d;
+                best_diff = diff;
+            }
+        }
+        int num_cols = 0;
+        if (best == -1) {
+            for (int c = 0; c < 256; c++) if (row[c] != -1) cols[num_cols++] = c;
+        } else {
+            const int* drow = dense->next + (size_t)best * 256;
+            for (int c = 0; c < 256; c++) if (row[c] != drow[c]) cols[num_cols++] = c;
+        }
+        t->default_state[s] = best;
+
+        // 首次适配：找最小的 base 使所有要存的列都落在空槽上
+        while (first_free < cap && t->check[first_free] != -1) first_free++;
+        int base = num_cols ? first_free - cols[0] : 0;
+        if (base < 0) base = 0;
+        for (;; base++) {
+            grow_comb_table(t, &cap, base + 256);
+            int fits = 1;
+            for (int k = 0; k < num_cols && fits; k++) fits = t->check[base + cols[k]] == -1;
+            if (fits) break;
+        }
+        t->base[s] = base;
+        for (int k = 0; k < num_cols; k++) {
+            t->check[base + cols[k]] = s;
+            t->next[base + cols[k]] = row[cols[k]];
+        }
+        if (base + 256 > t->size) t->size = base + 256;
+    }
+    // 每个 base 之后都留足 256 个槽，查表无需越界检查；多余的容量还给系统
+    t->next = realloc(t->next, (t->size + 1) * sizeof(int));
+    t->check = realloc(t->check, (t->size + 1) * sizeof(int));
+    return t;
+}
+
+void free_comb_table(struct CombTable* t) {
+    if (!t) return;
+    free(t->base);
+    free(t->default_state);
+    free(t->next);
+    free(t->check);
+    free(t->accept);
+    free(t);
+}
+
+size_t comb_table_memory(struct CombTable* t) {
+    return sizeof(struct CombTable) + (size_t)t->num_states * 3 * sizeof(int) + (size_t)t->size * 2 * sizeof(int);
+}
+
+// 压缩表上的最长匹配游标
+typedef struct {
+    const struct CombTable* t;
+    int state;
+} CombCursor;
+
+static inline void comb_reset(void* ctx) {
+    ((CombCursor*)ctx)->state = 0;
+}
+
+static inline int comb_step(void* ctx, unsigned char c) {
+    CombCursor* cur = ctx;
+    int next = comb_table_next(cur->t, cur->state, c);
+    if (next == -1) return 0;
+    cur->state = next;
+    return 1;
+}
+
+static inline int comb_accept(void* ctx) {
+    CombCursor* cur = ctx;
+    return cur->t->accept[cur->state];
+}
+
+static const LexMunchOps comb_ops = { comb_reset, comb_step, comb_accept };
+
+void comb_lexical_analysis(struct CombTable* t, char* input, int* segments, int* categories) {
+    CombCursor cur = { t, 0 };
+    lex_munch_segments(&comb_ops, &cur, input, strlen(input), segments, categories);
+}
@@ -0,0 +1,36 @@
+#ifndef COMB_TABLE_H_INCLUDED
+#define COMB_TABLE_H_INCLUDED
+
+#include <stddef.h>
+#include "dfa_table.h"
+
+// 压缩转移表（flex 式 comb-vector / 行位移）：每个状态只存与其默认状态不同的列，
+// 各行错位叠放进同一组 next / check 数组。查表时 check[base[s] + c] == s 说明该列属于 s，
+// 否则转到 default_state[s] 继续查，default_state 链上的编号严格递减，最终止于 -1（死状态）
+struct CombTable {
+    int num_states;
+    int size;           /* length of next / check */
+    int* base;          /* base[s] is the offset of row s in next / check */
+    int* default_state; /* default_state[s] < s, or -1 */
+    int* next;
+    int* check;         /* check[i] is the state owning slot i, or -1 if the slot is free */
+    int* accept;        /* accept[s] is the rule accepted in state s, or -1 */
+};
+
+struct CombTable* build_comb_table(struct DFATable* dense);
+void free_comb_table(struct CombTable* t);
+size_t comb_table_memory(struct CombTable* t);
+
+static inline int comb_table_next(const struct CombTable* t, int s, unsigned char c) {
+    while (s != -1) {
+        int i = t->base[s] + c;
+        if (t->check[i] == s) return t->next[i];
+        s = t->default_state[s];
+    }
+    return -1;
+}
+
+// 与 lexical_analysis 结果完全相同
+void comb_lexical_analysis(struct CombTable* t, char* input, int* segments, int* categories);
+
+#endif // COMB_TABLE_H_INCLUDED
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lang.h"
+#include "lexer.h"
+
+// 词法分析器生成的规模基准：按不同形状逐步放大规则集，记录 generate_lexer 各阶段耗时与 NFA / DFA 规模，输出 CSV
+// 用法：dfa_bench.exe [输出文件]，缺省写到标准输出
+// peak_rss 是整个进程的峰值，只增不减；单次构造的内存看 dfa_set_memory
+
+#define BENCH_MAX_WORD 12
+
+static unsigned int bench_state;
+
+static void bench_seed(unsigned int seed) {
+    bench_state = seed ? seed : 1;
+}
+
+// xorshift32，保证每次运行生成的规则集相同
+static unsigned int bench_rand(void) {
+    unsigned int x = bench_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bench_state = x;
+    return x;
+}
+
+// 随机关键字：首字母集中在少数几个字母上，让关键字之间有足够多的公共前缀
+static void random_keyword(char* word) {
+    int len = 2 + bench_rand() % (BENCH_MAX_WORD - 2);
+    word[0] = "cdefirstw"[bench_rand() % 9];
+    for (int i = 1; i < len; i++) word[i] = 'a' + bench_rand() % 26;
+    word[len] = '\0';
+}
+
+// n 条关键字规则，每个关键字单独成一条规则，最后是标识符
+static struct frontend_regexp** create_keyword_rules(int n, int* num_rules) {
+    struct frontend_regexp** regexps = malloc((n + 1) * sizeof(struct frontend_regexp*));
+    char word[BENCH_MAX_WORD + 1];
+    bench_seed(11);
+    for (int i = 0; i < n; i++) {
+        random_keyword(word);
+        regexps[i] = TFr_String(word);
+    }
+    regexps[n] = create_identifier_regex();
+    *num_rules = n + 1;
+    return regexps;
+}
+
+// 同样 n 个关键字放进一条并集规则，走字面量 trie 合并
+static struct frontend_regexp** create_keyword_union_rules(int n, int* num_rules) {
+    struct frontend_regexp** regexps = malloc(2 * sizeof(struct frontend_regexp*));
+    char word[BENCH_MAX_WORD + 1];
+    bench_seed(11);
+    struct frontend_regexp* keywords = NULL;
+    for (int i = 0; i < n; i++) {
+        random_keyword(word);
+        struct frontend_regexp* kw = TFr_String(word);
+        keywords = keywords ? TFr_Union(keywords, kw) : kw;
+    }
+    regexps[0] = keywords;
+    regexps[1] = create_identifier_regex();
+    *num_rules = 2;
+    return regexps;
+}
+
+// n 条互相重叠的字符集合规则 [lo-hi]+，区间随机，彼此大量交叠
+static struct frontend_regexp** create_char_class_rules(int n, int* num_rules) {
+    struct frontend_regexp** regexps = malloc(n * sizeof(struct frontend_regexp*));
+    bench_seed(12);
+    for (int i = 0; i < n; i++) {
+        char lo = 'a' + bench_rand() % 26;
+        char hi = lo + bench_rand() % ('z' - lo + 1);
+        regexps[i] = TFr_Plus(TFr_CharSet(create_char_set_from_range(lo, hi)));
+    }
+    *num_rules = n;
+    return regexps;
+}
+
+// 与测例 8 "(a|bc)+(de?)*" 同形的规则，字母依次错开，n 条
+static struct frontend_regexp** create_nested_rules(int n, int* num_rules) {
+    struct frontend_regexp** regexps = malloc(n * sizeof(struct frontend_regexp*));
+    for (int i = 0; i < n; i++) {
+        char c[5];
+        for (int k = 0; k < 5; k++) c[k] = 'a' + (i + k) % 26;
+        struct frontend_regexp* head = TFr_Plus(TFr_Union(TFr_SingleChar(c[0]), TFr_Concat(TFr_SingleChar(c[1]), TFr_SingleChar(c[2]))));
+        struct frontend_regexp* tail = TFr_Star(TFr_Concat(TFr_SingleChar(c[3]), TFr_Option(TFr_SingleChar(c[4]))));
+        regexps[i] = TFr_Concat(head, tail);
+    }
+    *num_rules = n;
+    return regexps;
+}
+
+// 单条规则，嵌套深度为 n：r_0 = (a|bc)+，r_k = (r_{k-1} (de?)*)+，每层换一组字母
+static struct frontend_regexp** create_nested_depth_rules(int n, int* num_rules) {
+    struct frontend_regexp** regexps = malloc(sizeof(struct frontend_regexp*));
+    struct frontend_regexp* r = TFr_Plus(TFr_Union(TFr_SingleChar('a'), TFr_Concat(TFr_SingleChar('b'), TFr_SingleChar('c'))));
+    for (int k = 1; k < n; k++) {
+        char d = 'a' + (3 * k) % 26, e = 'a' + (3 * k + 1) % 26;
+        struct frontend_regexp* tail = TFr_Star(TFr_Concat(TFr_SingleChar(d), TFr_Option(TFr_SingleChar(e))));
+        r = TFr_Plus(TFr_Concat(r, tail));
+    }
+    regexps[0] = r;
+    *num_rules = 1;
+    return regexps;
+}
+
+static const int keyword_sizes[] = {10, 30, 100, 300, 1000, 3000, 10000, 0};
+static const int char_class_sizes[] = {10, 20, 50, 100, 200, 500, 1000, 0};
+static const int nested_sizes[] = {1, 4, 16, 64, 256, 1024, 0};
+// r+ 展开为 r r*，每层复制一次子式，NFA 随深度指数增长，深度不宜再大
+static const int depth_sizes[] = {1, 2, 3, 4, 6, 8, 10, 12, 0};
+
+static const struct {
+    const char* name;
+    struct frontend_regexp** (*create)(int n, int* num_rules);
+    const int* sizes;
+} shapes[] = {
+    {"keyword-rules", create_keyword_rules, keyword_sizes},
+    {"keyword-union", create_keyword_union_rules, keyword_sizes},
+    {"char-classes", create_char_class_rules, char_class_sizes},
+    {"nested", create_nested_rules, nested_sizes},
+    {"nested-depth", create_nested_depth_rules, depth_sizes},
+};
+
+static const char* engine_name(enum LexerEngine engine) {
+    switch (engine) {
+    case LEXER_ENGINE_NFA: return "nfa";
+    case LEXER_ENGINE_SHIFT_AND: return "shift-and";
+    default: return "dfa";
+    }
+}
+
+int main(int argc, char** argv) {
+    FILE* out = stdout;
+    if (argc > 1) {
+        out = fopen(argv[1], "w");
+        if (!out) {
+            fprintf(stderr, "cannot open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    fprintf(out, "shape,size,rules,total_ms,simplify_ms,nfa_build_ms,combine_ms,dfa_ms,nfa_vertices,nfa_edges,"
+                 "closure_calls,byte_classes,dfa_states,dfa_edges,dfa_set_memory,peak_rss,engine\n");
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        for (int i = 0; shapes[s].sizes[i]; i++) {
+            int n = shapes[s].sizes[i], num_rules;
+            struct frontend_regexp** regexps = shapes[s].create(n, &num_rules);
+            struct LexerBuildReport report;
+            struct LexerOptions options = {0};
+            options.report = &report;
+            struct Lexer* lexer = generate_lexer_with_options(regexps, num_rules, &options);
+            fprintf(out, "%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%llu,%d,%d,%d,%llu,%llu,%s\n",
+                    shapes[s].name, n, num_rules, report.total_ms, report.simplify_ms, report.nfa_build_ms,
+                    report.combine_ms, report.dfa_ms, report.nfa_vertices, report.nfa_edges, report.closure_calls,
+                    report.byte_classes, report.dfa_states, report.dfa_edges,
+                    (unsigned long long)report.dfa_set_memory, (unsigned long long)report.peak_rss,
+                    engine_name(lexer->engine));
+            fflush(out);
+            free_lexer(lexer);
+            free(regexps);
+        }
+    }
+
+    if (out != stdout) fclose(out);
+    return 0;
+}
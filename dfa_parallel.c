@@ -0,0 +1,411 @@
+#define _POSIX_C_SOURCE 200809L
+#include "lexer.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 并行子集构造：多个工作线程从各自的双端队列取未展开的 DFA 状态（空闲时从别的线程队列另一端窃取），
+// 对每个字节类算 move 与 ε-闭包，新集合插入按哈希分片加锁的并发状态表。
+// 并行阶段的临时编号与调度有关；全部展开后按串行版本的 LIFO 工作表顺序重放一遍转移图重新编号，
+// 因此输出的 DFA（点编号与边的顺序）与 nfa_to_dfa_bounded 完全相同。
+
+#define PAR_SHARDS 64
+#define PAR_CHUNK_BITS 12
+#define PAR_CHUNK_SIZE (1 << PAR_CHUNK_BITS)
+#define PAR_MAX_CHUNKS (1 << 16)
+#define PAR_MAX_THREADS 64
+
+// 一个已发现的 DFA 状态；targets 由展开它的线程填写
+typedef struct {
+    int* set;
+    int size;
+    int* targets; /* for every byte class, the temporary id of the successor or -1 */
+} ParState;
+
+typedef struct {
+    pthread_mutex_t lock;
+    int* table;   /* open addressing over temporary ids, -1 for empty */
+    int table_size;
+    int count;
+} ParShard;
+
+typedef struct {
+    pthread_mutex_t lock;
+    int* items;
+    int head;     /* thieves take from head, the owner pushes and pops at tail */
+    int tail;
+    int cap;
+} ParDeque;
+
+typedef struct ParBuild ParBuild;
+
+typedef struct {
+    ParBuild* b;
+    int index;
+    int* buf;
+    int* mark;
+    int stamp;
+    unsigned long long closure_calls;
+    unsigned long long closure_vertices;
+} ParWorker;
+
+struct ParBuild {
+    NFAIndex* idx;
+    unsigned char classes[256];
+    int num_classes;
+    int class_rep[256];
+    bool class_live[256];
+    int max_states;
+    size_t max_memory;
+
+    ParShard shards[PAR_SHARDS];
+    _Atomic(ParState*) chunks[PAR_MAX_CHUNKS];
+    pthread_mutex_t chunk_lock;
+    atomic_int count;
+    atomic_size_t memory;
+    atomic_int pending;   /* states discovered but not yet expanded */
+    atomic_int over_budget;
+
+    int num_threads;
+    ParDeque deques[PAR_MAX_THREADS];
+};
+
+static unsigned int par_hash(const int* states, int size) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < size; i++) {
+        h ^= (unsigned int)states[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int par_compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static ParState* par_state(ParBuild* b, int id) {
+    ParState* chunk = atomic_load_explicit(&b->chunks[id >> PAR_CHUNK_BITS], memory_order_acquire);
+    return &chunk[id & (PAR_CHUNK_SIZE - 1)];
+}
+
+static void par_ensure_chunk(ParBuild* b, int id) {
+    int c = id >> PAR_CHUNK_BITS;
+    if (atomic_load_explicit(&b->chunks[c], memory_order_acquire)) return;
+    pthread_mutex_lock(&b->chunk_lock);
+    if (!atomic_load_explicit(&b->chunks[c], memory_order_relaxed)) {
+        atomic_store_explicit(&b->chunks[c], calloc(PAR_CHUNK_SIZE, sizeof(ParState)), memory_order_release);
+    }
+    pthread_mutex_unlock(&b->chunk_lock);
+}
+
+static void par_grow_shard(ParBuild* b, ParShard* sh) {
+    int new_size = sh->table_size * 2;
+    int* table = malloc(new_size * sizeof(int));
+    for (int i = 0; i < new_size; i++) table[i] = -1;
+    for (int i = 0; i < sh->table_size; i++) {
+        int id = sh->table[i];
+        if (id == -1) continue;
+        ParState* st = par_state(b, id);
+        unsigned int h = (par_hash(st->set, st->size) / PAR_SHARDS) & (new_size - 1);
+        while (table[h] != -1) h = (h + 1) & (new_size - 1);
+        table[h] = id;
+    }
+    free(sh->table);
+    sh->table = table;
+    sh->table_size = new_size;
+}
+
+// 查找有序集合 states；不存在时分配新的临时编号并置 *is_new。超出预算时返回 -1
+static int par_intern(ParBuild* b, const int* states, int size, int* is_new) {
+    unsigned int hash = par_hash(states, size);
+    ParShard* sh = &b->shards[hash % PAR_SHARDS];
+    *is_new = 0;
+    pthread_mutex_lock(&sh->lock);
+    if ((sh->count + 1) * 2 > sh->table_size) par_grow_shard(b, sh);
+    unsigned int h = (hash / PAR_SHARDS) & (sh->table_size - 1);
+    while (sh->table[h] != -1) {
+        ParState* st = par_state(b, sh->table[h]);
+        if (st->size == size && memcmp(st->set, states, size * sizeof(int)) == 0) {
+            int id = sh->table[h];
+            pthread_mutex_unlock(&sh->lock);
+            return id;
+        }
+        h = (h + 1) & (sh->table_size - 1);
+    }
+    // 与串行版本相同的预算口径：状态数与状态集合字节数
+    int id = atomic_fetch_add(&b->count, 1);
+    size_t memory = atomic_fetch_add(&b->memory, size * sizeof(int) + sizeof(int*) + sizeof(int)) +
+                    size * sizeof(int) + sizeof(int*) + sizeof(int);
+    if ((b->max_states > 0 && id + 1 > b->max_states) || (b->max_memory > 0 && memory > b->max_memory) ||
+        (id >> PAR_CHUNK_BITS) >= PAR_MAX_CHUNKS) {
+        atomic_store(&b->over_budget, 1);
+        pthread_mutex_unlock(&sh->lock);
+        return -1;
+    }
+    par_ensure_chunk(b, id);
+    ParState* st = par_state(b, id);
+    st->set = malloc((size + 1) * sizeof(int));
+    memcpy(st->set, states, size * sizeof(int));
+    st->size = size;
+    st->targets = malloc(b->num_classes * sizeof(int));
+    sh->table[h] = id;
+    sh->count++;
+    *is_new = 1;
+    pthread_mutex_unlock(&sh->lock);
+    return id;
+}
+
+static void par_push(ParDeque* q, int id) {
+    pthread_mutex_lock(&q->lock);
+    if (q->tail == q->cap) {
+        // 先把已被取走的前部挪掉，仍不够再扩容
+        memmove(q->items, q->items + q->head, (q->tail - q->head) * sizeof(int));
+        q->tail -= q->head;
+        q->head = 0;
+        if (q->tail == q->cap) {
+            q->cap *= 2;
+            q->items = realloc(q->items, q->cap * sizeof(int));
+        }
+    }
+    q->items[q->tail++] = id;
+    pthread_mutex_unlock(&q->lock);
+}
+
+static int par_pop(ParDeque* q) {
+    int id = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail > q->head) id = q->items[--q->tail];
+    pthread_mutex_unlock(&q->lock);
+    return id;
+}
+
+static int par_steal(ParDeque* q) {
+    int id = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail > q->head) id = q->items[q->head++];
+    pthread_mutex_unlock(&q->lock);
+    return id;
+}
+
+static void par_expand(ParWorker* w, int id) {
+    ParBuild* b = w->b;
+    NFAIndex* idx = b->idx;
+    ParState* cur = par_state(b, id);
+    for (int cls = 0; cls < b->num_classes; cls++) {
+        cur->targets[cls] = -1;
+        if (!b->class_live[cls] || atomic_load_explicit(&b->over_budget, memory_order_relaxed)) continue;
+        int c = b->class_rep[cls];
+        int* buf = w->buf;
+        int* mark = w->mark;
+        int stamp = ++w->stamp;
+        int size = 0;
+        for (int i = 0; i < cur->size; i++) {
+            int v = cur->set[i];
+            for (int k = idx->sym_start[v]; k < idx->sym_start[v + 1]; k++) {
+                int t = idx->sym_dst[k];
+                if (((idx->sym_bits[k][c >> 3] >> (c & 7)) & 1) && mark[t] != stamp) {
+                    mark[t] = stamp;
+                    buf[size++] = t;
+                }
+            }
+        }
+        if (size == 0) continue;
+        size = nfa_index_closure(idx, buf, size, mark, stamp);
+        w->closure_calls++;
+        w->closure_vertices += size;
+        qsort(buf, size, sizeof(int), par_compare_ints);
+        int is_new;
+        int target = par_intern(b, buf, size, &is_new);
+        if (target < 0) continue;
+        if (is_new) {
+            atomic_fetch_add(&b->pending, 1);
+            par_push(&b->deques[w->index], target);
+        }
+        cur->targets[cls] = target;
+    }
+}
+
+static void* par_worker_main(void* arg) {
+    ParWorker* w = arg;
+    ParBuild* b = w->b;
+    while (1) {
+        int id = par_pop(&b->deques[w->index]);
+        for (int k = 1; id < 0 && k < b->num_threads; k++) {
+            id = par_steal(&b->deques[(w->index + k) % b->num_threads]);
+        }
+        if (id < 0) {
+            if (atomic_load(&b->pending) == 0) break;
+            sched_yield();
+            continue;
+        }
+        par_expand(w, id);
+        atomic_fetch_sub(&b->pending, 1);
+    }
+    return NULL;
+}
+
+static void par_free_build(ParBuild* b) {
+    int count = atomic_load(&b->count);
+    for (int c = 0; c < PAR_MAX_CHUNKS; c++) {
+        ParState* chunk = atomic_load(&b->chunks[c]);
+        if (!chunk) continue;
+        for (int i = 0; i < PAR_CHUNK_SIZE && (c << PAR_CHUNK_BITS) + i < count; i++) {
+            free(chunk[i].set);
+            free(chunk[i].targets);
+        }
+        free(chunk);
+    }
+    for (int s = 0; s < PAR_SHARDS; s++) {
+        pthread_mutex_destroy(&b->shards[s].lock);
+        free(b->shards[s].table);
+    }
+    for (int t = 0; t < b->num_threads; t++) {
+        pthread_mutex_destroy(&b->deques[t].lock);
+        free(b->deques[t].items);
+    }
+    pthread_mutex_destroy(&b->chunk_lock);
+    free_nfa_index(b->idx);
+    free(b);
+}
+
+// 与 nfa_to_dfa_profiled 接口和结果相同，num_threads 个线程并行展开状态；num_threads <= 1 时直接走串行版本
+struct finite_automata* nfa_to_dfa_parallel(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules,
+                                            int max_states, size_t max_memory, int num_threads, struct LexerBuildReport* report) {
+    if (num_threads <= 1 || nfa->n == 0) {
+        return nfa_to_dfa_profiled(nfa, accepting_states, num_accepting, dfa_accepting_rules, max_states, max_memory, report);
+    }
+    if (num_threads > PAR_MAX_THREADS) num_threads = PAR_MAX_THREADS;
+
+    ParBuild* b = calloc(1, sizeof(ParBuild));
+    b->idx = build_nfa_index(nfa);
+    b->num_classes = compute_byte_classes(b->idx, b->classes);
+    for (int c = 255; c >= 0; c--) b->class_rep[b->classes[c]] = c;
+    for (int k = 0; k < b->idx->sym_start[b->idx->n]; k++) {
+        for (int c = 0; c < 256; c++) {
+            if ((b->idx->sym_bits[k][c >> 3] >> (c & 7)) & 1) b->class_live[b->classes[c]] = true;
+        }
+    }
+    b->max_states = max_states;
+    b->max_memory = max_memory;
+    b->num_threads = num_threads;
+    pthread_mutex_init(&b->chunk_lock, NULL);
+    for (int s = 0; s < PAR_SHARDS; s++) {
+        pthread_mutex_init(&b->shards[s].lock, NULL);
+        b->shards[s].table_size = 64;
+        b->shards[s].table = malloc(64 * sizeof(int));
+        for (int i = 0; i < 64; i++) b->shards[s].table[i] = -1;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_mutex_init(&b->deques[t].lock, NULL);
+        b->deques[t].cap = 64;
+        b->deques[t].items = malloc(64 * sizeof(int));
+    }
+
+    ParWorker* workers = calloc(num_threads, sizeof(ParWorker));
+    for (int t = 0; t < num_threads; t++) {
+        workers[t].b = b;
+        workers[t].index = t;
+        workers[t].buf = malloc((nfa->n + 1) * sizeof(int));
+        workers[t].mark = calloc(nfa->n + 1, sizeof(int));
+    }
+
+    // 起始状态由当前线程放入 0 号工作线程的队列，临时编号必为 0
+    ParWorker* w0 = &workers[0];
+    int size = 0;
+    w0->buf[size++] = 0;
+    w0->mark[0] = ++w0->stamp;
+    size = nfa_index_closure(b->idx, w0->buf, size, w0->mark, w0->stamp);
+    w0->closure_calls++;
+    w0->closure_vertices += size;
+    qsort(w0->buf, size, sizeof(int), par_compare_ints);
+    int is_new;
+    par_intern(b, w0->buf, size, &is_new);
+    atomic_fetch_sub(&b->memory, sizeof(int*) + sizeof(int)); /* the serial build does not charge the start state's overhead */
+    atomic_store(&b->pending, 1);
+    par_push(&b->deques[0], 0);
+
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    for (int t = 1; t < num_threads; t++) pthread_create(&threads[t], NULL, par_worker_main, &workers[t]);
+    par_worker_main(&workers[0]);
+    for (int t = 1; t < num_threads; t++) pthread_join(threads[t], NULL);
+    free(threads);
+
+    int over_budget = atomic_load(&b->over_budget);
+    int count = atomic_load(&b->count);
+    if (report) {
+        for (int t = 0; t < num_threads; t++) {
+            report->closure_calls += workers[t].closure_calls;
+            report->closure_vertices += workers[t].closure_vertices;
+        }
+        report->byte_classes = b->num_classes;
+        report->alphabet_size = 0;
+        for (int cls = 0; cls < b->num_classes; cls++) report->alphabet_size += b->class_live[cls];
+        report->dfa_states = count;
+        report->dfa_set_memory = atomic_load(&b->memory);
+        report->dfa_over_budget = over_budget;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        free(workers[t].buf);
+        free(workers[t].mark);
+    }
+    free(workers);
+    if (over_budget) {
+        par_free_build(b);
+        *dfa_accepting_rules = NULL;
+        return NULL;
+    }
+
+    // 按串行版本的顺序重放：弹出栈顶，依次看每个字节类，新目标按发现顺序编号并入栈
+    struct finite_automata* dfa = create_empty_graph();
+    int* serial_id = malloc(count * sizeof(int));
+    int* order = malloc(count * sizeof(int));
+    int* stack = malloc(count * sizeof(int));
+    for (int i = 0; i < count; i++) serial_id[i] = -1;
+    int discovered = 0, stack_count = 0;
+    serial_id[0] = discovered;
+    order[discovered++] = 0;
+    stack[stack_count++] = 0;
+    for (int i = 0; i < count; i++) add_one_vertex(dfa);
+    int byte_target[256];
+    while (stack_count > 0) {
+        int current = stack[--stack_count];
+        ParState* st = par_state(b, current);
+        for (int cls = 0; cls < b->num_classes; cls++) {
+            int target = st->targets[cls];
+            if (target >= 0 && serial_id[target] == -1) {
+                serial_id[target] = discovered;
+                order[discovered++] = target;
+                stack[stack_count++] = target;
+            }
+        }
+        for (int c = 0; c < 256; c++) {
+            int target = st->targets[b->classes[c]];
+            byte_target[c] = target >= 0 ? serial_id[target] : -1;
+        }
+        add_grouped_edges(dfa, serial_id[current], byte_target);
+    }
+
+    // 标记接受状态：集合中编号最大的接受点决定规则
+    int* accept_rule_of = build_accept_rule_map(nfa, accepting_states, num_accepting);
+    int* rules = malloc((count + 1) * sizeof(int));
+    for (int id = 0; id < count; id++) {
+        ParState* st = par_state(b, order[id]);
+        rules[id] = -1;
+        for (int i = 0; i < st->size; i++) {
+            int r = accept_rule_of[st->set[i]];
+            if (r != -1) rules[id] = r;
+        }
+    }
+    *dfa_accepting_rules = rules;
+    if (report) report->dfa_edges = dfa->m;
+
+    free(accept_rule_of);
+    free(serial_id);
+    free(order);
+    free(stack);
+    par_free_build(b);
+    return dfa;
+}
@@ -0,0 +1,152 @@
+#include "dfa_table.h"
+#include "lexer_munch.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct DFATable* build_dfa_table(struct finite_automata* dfa, int* accepting_rules) {
+    struct DFATable* t = malloc(sizeof(struct DFATable));
+    int n = dfa->n;
+    t->num_states = n;
+    t->next = malloc(((size_t)n * 256 + 1) * sizeof(int));
+    t->accept = malloc((n + 1) * sizeof(int));
+    for (size_t i = 0; i < (size_t)n * 256; i++) t->next[i] = -1;
+    for (int e = 0; e < dfa->m; e++) {
+        int* row = t->next + (size_t)dfa->src[e] * 256;
+        for (unsigned int i = 0; i < dfa->lb[e].n; i++) {
+            row[(unsigned char)dfa->lb[e].c[i]] = dfa->dst[e];
+        }
+    }
+    for (int s = 0; s < n; s++) t->accept[s] = accepting_rules ? accepting_rules[s] : -1;
+    return t;
+}
+
+void free_dfa_table(struct DFATable* t) {
+    if (!t) return;
+    free(t->next);
+    free(t->accept);
+    free(t);
+}
+
+size_t dfa_table_memory(struct DFATable* t) {
+    return sizeof(struct DFATable) + (size_t)t->num_states * (256 + 1) * sizeof(int);
+}
+
+// 稠密表上的最长匹配游标；visits 非空时累计每个状态读入的字节数
+typedef struct {
+    const struct DFATable* t;
+    int state;
+    unsigned long long* visits;
+} TableCursor;
+
+static inline void table_reset(void* ctx) {
+    ((TableCursor*)ctx)->state = 0;
+}
+
+static inline int table_step(void* ctx, unsigned char c) {
+    TableCursor* cur = ctx;
+    if (cur->visits) cur->visits[cur->state]++;
+    int next = cur->t->next[(size_t)cur->state * 256 + c];
+    if (next == -1) return 0;
+    cur->state = next;
+    return 1;
+}
+
+static inline int table_accept(void* ctx) {
+    TableCursor* cur = ctx;
+    return cur->t->accept[cur->state];
+}
+
+static const LexMunchOps table_ops = { table_reset, table_step, table_accept };
+
+void table_lexical_analysis(struct DFATable* t, char* input, int* segments, int* categories) {
+    TableCursor cur = { t, 0, NULL };
+    lex_munch_segments(&table_ops, &cur, input, strlen(input), segments, categories);
+}
+
+// 在训练语料上跑一遍词法分析，把每个状态的访问次数累加到 visits[0 .. num_states)
+void dfa_table_count_visits(struct DFATable* t, char* input, unsigned long long* visits) {
+    TableCursor cur = { t, 0, visits };
+    struct LexMunch m;
+    lex_munch_init(&m, 0);
+    while (lex_munch(&table_ops, &cur, &m, (const unsigned char*)input, strlen(input), 1) == LEX_MUNCH_UNIT) {}
+}
+
+typedef struct {
+    unsigned long long weight;
+    int bfs;     /* BFS position, breaks ties */
+    int state;
+} WeightedState;
+
+// 访问次数多的在前，次数相同时保持 BFS 顺序；键都在元素里，排序可重入
+static int compare_by_weight(const void* a, const void* b) {
+    const WeightedState* x = a;
+    const WeightedState* y = b;
+    if (x->weight != y->weight) return x->weight < y->weight ? 1 : -1;
+    return (x->bfs > y->bfs) - (x->bfs < y->bfs);
+}
+
+void reorder_dfa_table(struct DFATable* t, const unsigned long long* weights) {
+    reorder_dfa_table_tracked(t, weights, NULL);
+}
+
+void reorder_dfa_table_tracked(struct DFATable* t, const unsigned long long* weights, int* renumber) {
+    int n = t->num_states;
+    if (n <= 1) {
+        if (renumber && n == 1) renumber[0] = 0;
+        return;
+    }
+    // order[i] 是新编号 i 对应的旧状态；先按 BFS 排，不可达的状态接在最后
+    int* order = malloc(n * sizeof(int));
+    int* new_id = malloc(n * sizeof(int));
+    for (int s = 0; s < n; s++) new_id[s] = -1;
+    int count = 0;
+    order[count++] = 0;
+    new_id[0] = 0;
+    for (int head = 0; head < count; head++) {
+        const int* row = t->next + (size_t)order[head] * 256;
+        for (int c = 0; c < 256; c++) {
+            int d = row[c];
+            if (d != -1 && new_id[d] == -1) {
+                new_id[d] = count;
+                order[count++] = d;
+            }
+        }
+    }
+    for (int s = 0; s < n; s++) {
+        if (new_id[s] == -1) {
+            new_id[s] = count;
+            order[count++] = s;
+        }
+    }
+    if (weights) {
+        // 按访问次数重新排序，起始状态不参与
+        WeightedState* by_weight = malloc(n * sizeof(WeightedState));
+        for (int i = 0; i < n; i++) {
+            by_weight[i].weight = weights[order[i]];
+            by_weight[i].bfs = i;
+            by_weight[i].state = order[i];
+        }
+        qsort(by_weight + 1, n - 1, sizeof(WeightedState), compare_by_weight);
+        for (int i = 0; i < n; i++) {
+            order[i] = by_weight[i].state;
+            new_id[order[i]] = i;
+        }
+        free(by_weight);
+    }
+
+    int* next = malloc(((size_t)n * 256 + 1) * sizeof(int));
+    int* accept = malloc((n + 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        const int* src = t->next + (size_t)order[i] * 256;
+        int* dst = next + (size_t)i * 256;
+        for (int c = 0; c < 256; c++) dst[c] = src[c] == -1 ? -1 : new_id[src[c]];
+        accept[i] = t->accept[order[i]];
+    }
+    free(t->next);
+    free(t->accept);
+    t->next = next;
+    t->accept = accept;
+    if (renumber) memcpy(renumber, new_id, n * sizeof(int));
+    free(order);
+    free(new_id);
+}
@@ -0,0 +1,28 @@
+#ifndef DFA_TABLE_H_INCLUDED
+#define DFA_TABLE_H_INCLUDED
+
+#include <stddef.h>
+#include "lang.h"
+
+// 稠密转移表：每个 DFA 状态一行 256 列，热循环里每个字节只需一次查表
+struct DFATable {
+    int num_states;
+    int* next;   /* next[s * 256 + c] is the successor of state s on byte c, or -1 */
+    int* accept; /* accept[s] is the rule accepted in state s, or -1; kept apart from the rows */
+};
+
+struct DFATable* build_dfa_table(struct finite_automata* dfa, int* accepting_rules);
+void free_dfa_table(struct DFATable* t);
+size_t dfa_table_memory(struct DFATable* t);
+
+// 与 lexical_analysis 结果完全相同，只是转移改为查表
+void table_lexical_analysis(struct DFATable* t, char* input, int* segments, int* categories);
+
+// 状态重新编号，让经常一起访问的状态落在相邻的行：
+// weights 非空时按访问次数从高到低排列，否则按从起始状态出发的 BFS 顺序；起始状态始终是 0
+void dfa_table_count_visits(struct DFATable* t, char* input, unsigned long long* visits);
+void reorder_dfa_table(struct DFATable* t, const unsigned long long* weights);
+// 同 reorder_dfa_table；renumber 非空时写入 renumber[旧编号] = 新编号（num_states 项）
+void reorder_dfa_table_tracked(struct DFATable* t, const unsigned long long* weights, int* renumber);
+
+#endif // DFA_TABLE_H_INCLUDED
@@ -13,6 +13,7 @@
 extern "C" {
 #include "lang.h"
 #include "lexer.h"
+#include "regexp_unicode.h"
 }
 
 using namespace Gdiplus;
@@ -55,20 +56,32 @@ char read_escape(char c) {
 }
 
 struct Parser {
-    explicit Parser(const std::string& src) : text(src), pos(0) {}
+    explicit Parser(const std::string& src) : text(src), pos(0), fold_case(false) {}
 
+    // 开头的 (?i) 使整条正则不区分大小写
     struct frontend_regexp* parse() {
+        skip_spaces();
+        if (text.compare(pos, 4, "(?i)") == 0) {
+            fold_case = true;
+            pos += 4;
+        }
         auto* result = parse_union();
         skip_spaces();
         if (pos != text.size()) {
             throw std::runtime_error("Unexpected trailing characters in regex.");
         }
+        if (fold_case) {
+            frontend_regexp* folded = fold_case_regexp(result);
+            free_frontend_regexp(result);
+            result = folded;
+        }
         return result;
     }
 
 private:
     const std::string text;
     size_t pos;
+    bool fold_case;
 
     bool eof() const { return pos >= text.size(); }
     char peek() const { return eof() ? '\0' : text[pos]; }
@@ -136,8 +149,7 @@ private:
             return inner;
         }
         if (c == '[') {
-            struct char_set* cs = parse_char_set();
-            return TFr_CharSet(cs);
+            return parse_char_set();
         }
         if (c == '"') {
             std::string s = parse_string_literal();
@@ -146,63 +158,145 @@ private:
         if (c == '\\') {
             advance();
             if (eof()) throw std::runtime_error("Dangling escape.");
-            char escaped = read_escape(advance());
-            return TFr_SingleChar(escaped);
+            char escaped = advance();
+            if (escaped == 'u') return code_point_atom(read_code_point_escape());
+            return TFr_SingleChar(read_escape(escaped));
         }
         if (c == '|' || c == ')' ) {
             throw std::runtime_error("Unexpected operator position.");
         }
+        // 多字节的 UTF-8 字符整个作为一个原子，其后的 * + ? 作用于整个字符
+        unsigned int cp;
+        if (read_utf8(&cp)) return code_point_atom(cp);
         advance();
         return TFr_SingleChar(c);
     }
 
+    frontend_regexp* code_point_atom(unsigned int cp) {
+        if (cp < 0x80) return TFr_SingleChar(static_cast<char>(cp));
+        std::string bytes = encode_utf8(cp);
+        return TFr_String(bytes.data());
+    }
+
+    static std::string encode_utf8(unsigned int cp) {
+        char buf[4];
+        return std::string(buf, utf8_encode(cp, buf));
+    }
+
+    // 当前位置是合法的多字节 UTF-8 字符时读入整个字符，否则不前进并返回 0
+    int read_utf8(unsigned int* cp) {
+        if (static_cast<unsigned char>(peek()) < 0x80) return 0;
+        int n = utf8_decode(text.data() + pos, static_cast<int>(text.size() - pos), cp);
+        pos += n;
+        return n;
+    }
+
+    // \u{...} 中的十六进制码点，"\u" 已读过
+    unsigned int read_code_point_escape() {
+        if (peek() != '{') throw std::runtime_error("Expected '{' after \\u.");
+        advance();
+        unsigned int cp = 0;
+        int digits = 0;
+        while (!eof() && isxdigit(static_cast<unsigned char>(peek()))) {
+            char h = advance();
+            cp = cp * 16 + (isdigit(static_cast<unsigned char>(h)) ? h - '0' : tolower(static_cast<unsigned char>(h)) - 'a' + 10);
+            if (++digits > 6) throw std::runtime_error("Code point escape is too long.");
+        }
+        if (digits == 0 || peek() != '}') throw std::runtime_error("Malformed \\u{...} escape.");
+        advance();
+        if (cp > UTF8_MAX_CODE_POINT || (cp >= 0xD800 && cp <= 0xDFFF)) throw std::runtime_error("Code point out of range.");
+        return cp;
+    }
+
     std::string parse_string_literal() {
         if (peek() != '"') throw std::runtime_error("String literal must start with \".");
         advance(); // consume "
         std::string out;
         while (!eof() && peek() != '"') {
-            out.push_back(advance());
+            char c = advance();
+            if (c == '\\') {
+                if (eof()) throw std::runtime_error("Dangling escape in string literal.");
+                c = advance();
+                if (c == 'u') {
+                    out += encode_utf8(read_code_point_escape());
+                    continue;
+                }
+                c = read_escape(c);
+            }
+            out.push_back(c);
         }
         if (peek() != '"') throw std::runtime_error("Missing closing quote for string literal.");
         advance(); // consume closing "
         return out;
     }
 
-    struct char_set* parse_char_set() {
+    // 出现多字节的 UTF-8 字符或 \u{...} 时按码点区间编译成字节级的子自动机，否则仍是单字节的字符集
+    frontend_regexp* parse_char_set() {
         if (peek() != '[') throw std::runtime_error("Character set must start with '['.");
         advance();
-        std::vector<unsigned char> chars;
+        std::vector<unsigned int> ranges;
+        bool unicode = false;
         bool closed = false;
         while (!eof()) {
-            char c = advance();
-            if (c == ']') { closed = true; break; }
-            if (c == '\\') {
-                if (eof()) throw std::runtime_error("Dangling escape in character set.");
-                c = read_escape(advance());
+            if (peek() == ']') {
+                advance();
+                closed = true;
+                break;
             }
+            unsigned int lo = read_set_char(&unicode);
+            unsigned int hi = lo;
             if (peek() == '-' && (pos + 1) < text.size() && text[pos + 1] != ']') {
                 advance(); // consume '-'
-                char end_ch = advance();
-                if (end_ch == '\\') {
-                    if (eof()) throw std::runtime_error("Dangling escape in character set range.");
-                    end_ch = read_escape(advance());
-                }
-                if (end_ch < c) std::swap(end_ch, c);
-                for (unsigned char ch = static_cast<unsigned char>(c); ch <= static_cast<unsigned char>(end_ch); ++ch) {
-                    chars.push_back(ch);
-                }
-            } else {
-                chars.push_back(static_cast<unsigned char>(c));
+                if (eof()) throw std::runtime_error("Dangling escape in character set range.");
+                hi = read_set_char(&unicode);
+                if (hi < lo) std::swap(lo, hi);
             }
+            ranges.push_back(lo);
+            ranges.push_back(hi);
         }
         if (!closed) throw std::runtime_error("Missing closing ']' for character set.");
+        if (unicode) {
+            frontend_regexp* cls = utf8_class_regexp(ranges.data(), static_cast<int>(ranges.size() / 2), fold_case ? UTF8_CLASS_FOLD_CASE : 0);
+            if (!cls) throw std::runtime_error("Empty character class.");
+            return cls;
+        }
+        std::vector<unsigned char> chars;
+        for (size_t i = 0; i < ranges.size(); i += 2) {
+            for (unsigned int ch = ranges[i]; ch <= ranges[i + 1]; ++ch) {
+                chars.push_back(static_cast<unsigned char>(ch));
+            }
+        }
         auto* cs = static_cast<char_set*>(malloc(sizeof(char_set)));
         cs->n = static_cast<unsigned int>(chars.size());
         cs->c = static_cast<char*>(malloc(cs->n));
         for (unsigned int i = 0; i < cs->n; i++) {
             cs->c[i] = static_cast<char>(chars[i]);
         }
-        return cs;
+        return TFr_CharSet(cs);
+    }
+
+    // 字符集中的一个字符：单字节的值，或者（置 *unicode）一个码点
+    unsigned int read_set_char(bool* unicode) {
+        unsigned int cp;
+        if (read_utf8(&cp)) {
+            *unicode = true;
+            return cp;
+        }
+        char c = advance();
+        if (c == '\\') {
+            if (eof()) throw std::runtime_error("Dangling escape in character set.");
+            if (read_utf8(&cp)) {
+                *unicode = true;
+                return cp;
+            }
+            c = advance();
+            if (c == 'u') {
+                *unicode = true;
+                return read_code_point_escape();
+            }
+            c = read_escape(c);
+        }
+        return static_cast<unsigned char>(c);
     }
 };
 
@@ -251,44 +345,7 @@ std::string format_characters_only(const std::vector<unsigned char>& chars) {
 
 std::string format_charset(const std::vector<unsigned char>& chars, bool epsilon) {
     if (epsilon) return "eps";
-    if (chars.empty()) return "";
-    std::vector<unsigned char> sorted = chars;
-    std::sort(sorted.begin(), sorted.end());
-    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
-
-    std::vector<unsigned char> char_only;
-    std::vector<unsigned char> string_tokens;
-    for (unsigned char c : sorted) {
-        if (is_string_token_char(c)) {
-            string_tokens.push_back(c);
-        } else {
-            char_only.push_back(c);
-        }
-    }
-
-    std::vector<std::string> parts;
-    if (!char_only.empty()) {
-        parts.push_back(format_characters_only(char_only));
-    }
-    for (unsigned char token : string_tokens) {
-        const char* label = get_string_token_label(token);
-        if (label) {
-            std::ostringstream os;
-            os << "\"" << label << "\"";
-            parts.push_back(os.str());
-        } else {
-            parts.push_back(printable_char(token));
-        }
-    }
-
-    if (parts.empty()) return "";
-    if (parts.size() == 1) return parts[0];
-    std::ostringstream merged;
-    for (size_t i = 0; i < parts.size(); ++i) {
-        if (i > 0) merged << " | ";
-        merged << parts[i];
-    }
-    return merged.str();
+    return format_characters_only(chars);
 }
 
 struct EdgeAggregate {
@@ -651,19 +708,18 @@ int main() {
         if (input == "quit") break;
         if (input.empty()) continue;
         try {
-            reset_string_token_table();
             Parser parser(input);
             frontend_regexp* fr = parser.parse();
             simpl_regexp* sr = simplify_regexp(fr);
 
-            finite_automata* nfa = create_empty_graph();
-            NFAFragment frag = regexp_to_nfa_fragment(nfa, sr);
-            int accepting_states[1] = {frag.end};
-            std::vector<int> dfa_accepting_rules(1000, -1);
-            finite_automata* dfa = nfa_to_dfa(nfa, accepting_states, 1, dfa_accepting_rules.data());
+            finite_automata* nfa = build_nfa_from_regexp(sr);
+            int accepting_states[1] = {nfa->n - 1};
+            int* dfa_accepting_rules = nullptr;
+            finite_automata* dfa = nfa_to_dfa(nfa, accepting_states, 1, &dfa_accepting_rules);
 
             std::string filename = "dfa_" + std::to_string(vis_index++) + ".png";
-            render_dfa(dfa, dfa_accepting_rules.data(), filename);
+            render_dfa(dfa, dfa_accepting_rules, filename);
+            free(dfa_accepting_rules);
             std::cout << "Saved: " << filename << std::endl;
         } catch (const std::exception& ex) {
             std::cerr << "Error: " << ex.what() << std::endl;
@@ -0,0 +1,176 @@
+#include "keyword_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 带种子的 FNV-1a，最后再做一次混合，使不同种子下的结果足够独立
+static unsigned int keyword_hash(const char* s, int len, unsigned int seed) {
+    unsigned int h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+// 排序的元素自带比较所需的数据，比较函数不依赖全局状态，多个线程可以同时建表
+typedef struct {
+    const char* key;
+    int index;
+} KeywordRef;
+
+static int compare_keyword_ref(const void* a, const void* b) {
+    const KeywordRef* x = a;
+    const KeywordRef* y = b;
+    int c = strcmp(x->key, y->key);
+    if (c != 0) return c;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+typedef struct {
+    int size;
+    int bucket;
+} BucketSize;
+
+static int compare_bucket_size(const void* a, const void* b) {
+    const BucketSize* x = a;
+    const BucketSize* y = b;
+    if (x->size != y->size) return y->size - x->size;
+    return x->bucket - y->bucket;
+}
+
+// 按桶大小从大到小依次为每个桶找一个种子，使桶内关键字落入互不相同的空槽
+static int place_buckets(struct KeywordTable* t, const char** keys, int* bucket_start, int* bucket_keys, int* order, int* slot_of) {
+    int* taken = calloc(t->table_size, sizeof(int));
+    int* trial = malloc((t->n + 1) * sizeof(int));
+    int ok = 1;
+    for (int oi = 0; oi < t->num_buckets && ok; oi++) {
+        int b = order[oi];
+        int* members = bucket_keys + bucket_start[b];
+        int count = bucket_start[b + 1] - bucket_start[b];
+        t->seeds[b] = 0;
+        if (count == 0) continue;
+        int placed = 0;
+        for (unsigned int seed = 1; seed < (1u << 16) && !placed; seed++) {
+            placed = 1;
+            for (int i = 0; i < count && placed; i++) {
+                const char* key = keys[members[i]];
+                int slot = (int)(keyword_hash(key, (int)strlen(key), seed) % (unsigned int)t->table_size);
+                if (taken[slot]) { placed = 0; break; }
+                for (int j = 0; j < i; j++) {
+                    if (trial[j] == slot) { placed = 0; break; }
+                }
+                trial[i] = slot;
+            }
+            if (placed) {
+                t->seeds[b] = (int)seed;
+                for (int i = 0; i < count; i++) {
+                    taken[trial[i]] = 1;
+                    slot_of[members[i]] = trial[i];
+                }
+            }
+        }
+        if (!placed) ok = 0;
+    }
+    free(taken);
+    free(trial);
+    return ok;
+}
+
+struct KeywordTable* build_keyword_table(const char** keywords, const int* categories, int n) {
+    struct KeywordTable* t = calloc(1, sizeof(struct KeywordTable));
+    // 重复的关键字只保留第一次出现（排序后相邻比较，避免平方级的两两比较）
+    KeywordRef* by_key = malloc((n + 1) * sizeof(KeywordRef));
+    char* duplicate = calloc(n + 1, 1);
+    for (int i = 0; i < n; i++) {
+        by_key[i].key = keywords[i];
+        by_key[i].index = i;
+    }
+    qsort(by_key, n, sizeof(KeywordRef), compare_keyword_ref);
+    for (int i = 1; i < n; i++) {
+        if (strcmp(by_key[i - 1].key, by_key[i].key) == 0) duplicate[by_key[i].index] = 1;
+    }
+    const char** keys = malloc((n + 1) * sizeof(char*));
+    int* cats = malloc((n + 1) * sizeof(int));
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (duplicate[i]) continue;
+        keys[count] = keywords[i];
+        cats[count] = categories[i];
+        count++;
+    }
+    free(by_key);
+    free(duplicate);
+    t->n = count;
+    t->num_buckets = count / 2 + 1;
+    t->table_size = count > 0 ? count : 1;
+    t->seeds = calloc(t->num_buckets, sizeof(int));
+
+    int* bucket_of = malloc((count + 1) * sizeof(int));
+    int* bucket_start = calloc(t->num_buckets + 1, sizeof(int));
+    for (int k = 0; k < count; k++) {
+        bucket_of[k] = (int)(keyword_hash(keys[k], (int)strlen(keys[k]), 0) % (unsigned int)t->num_buckets);
+        bucket_start[bucket_of[k] + 1]++;
+    }
+    for (int b = 0; b < t->num_buckets; b++) bucket_start[b + 1] += bucket_start[b];
+    int* bucket_keys = malloc((count + 1) * sizeof(int));
+    int* fill = malloc((t->num_buckets + 1) * sizeof(int));
+    memcpy(fill, bucket_start, (t->num_buckets + 1) * sizeof(int));
+    for (int k = 0; k < count; k++) bucket_keys[fill[bucket_of[k]]++] = k;
+    free(fill);
+    BucketSize* by_size = malloc(t->num_buckets * sizeof(BucketSize));
+    for (int b = 0; b < t->num_buckets; b++) {
+        by_size[b].size = bucket_start[b + 1] - bucket_start[b];
+        by_size[b].bucket = b;
+    }
+    qsort(by_size, t->num_buckets, sizeof(BucketSize), compare_bucket_size);
+    int* order = malloc(t->num_buckets * sizeof(int));
+    for (int b = 0; b < t->num_buckets; b++) order[b] = by_size[b].bucket;
+    free(by_size);
+    int* slot_of = malloc((count + 1) * sizeof(int));
+    // 极少数情况下找不到种子，此时放宽槽数重试，表不再最小但仍是完美哈希
+    while (!place_buckets(t, keys, bucket_start, bucket_keys, order, slot_of)) {
+        t->table_size += t->table_size / 8 + 1;
+    }
+
+    t->keys = calloc(t->table_size, sizeof(char*));
+    t->lengths = calloc(t->table_size, sizeof(int));
+    t->categories = malloc(t->table_size * sizeof(int));
+    for (int s = 0; s < t->table_size; s++) t->categories[s] = -1;
+    for (int k = 0; k < count; k++) {
+        int s = slot_of[k];
+        int len = (int)strlen(keys[k]);
+        t->keys[s] = malloc(len + 1);
+        memcpy(t->keys[s], keys[k], len + 1);
+        t->lengths[s] = len;
+        t->categories[s] = cats[k];
+    }
+    free(keys);
+    free(cats);
+    free(bucket_of);
+    free(bucket_start);
+    free(bucket_keys);
+    free(order);
+    free(slot_of);
+    return t;
+}
+
+int keyword_table_lookup(struct KeywordTable* t, const char* s, int len) {
+    if (!t || t->n == 0) return -1;
+    unsigned int b = keyword_hash(s, len, 0) % (unsigned int)t->num_buckets;
+    unsigned int slot = keyword_hash(s, len, (unsigned int)t->seeds[b]) % (unsigned int)t->table_size;
+    if (t->lengths[slot] != len || !t->keys[slot] || memcmp(t->keys[slot], s, len) != 0) return -1;
+    return t->categories[slot];
+}
+
+void free_keyword_table(struct KeywordTable* t) {
+    if (!t) return;
+    for (int s = 0; s < t->table_size; s++) free(t->keys[s]);
+    free(t->keys);
+    free(t->lengths);
+    free(t->categories);
+    free(t->seeds);
+    free(t);
+}
@@ -0,0 +1,20 @@
+#ifndef KEYWORD_HASH_H_INCLUDED
+#define KEYWORD_HASH_H_INCLUDED
+
+// 关键字表：生成词法分析器时为关键字集合构造最小完美哈希（hash-and-displace），
+// 查表只需一次哈希探测和一次比较
+struct KeywordTable {
+    int n;            /* number of keywords */
+    int table_size;   /* number of slots, equal to n unless the seed search had to widen the table */
+    int num_buckets;
+    int* seeds;       /* for every bucket b, seeds[b] is the displacement seed of the keys in b */
+    char** keys;      /* for every slot s, keys[s] is the keyword stored there, or NULL */
+    int* lengths;
+    int* categories;
+};
+
+struct KeywordTable* build_keyword_table(const char** keywords, const int* categories, int n);
+int keyword_table_lookup(struct KeywordTable* t, const char* s, int len); /* return the category of s, or -1 if s is not a keyword */
+void free_keyword_table(struct KeywordTable* t);
+
+#endif // KEYWORD_HASH_H_INCLUDED
@@ -44,7 +44,9 @@ struct frontend_regexp * TFr_Plus(struct frontend_regexp * r) {
 struct frontend_regexp * TFr_String(char * s) {
     struct frontend_regexp * fr = malloc(sizeof(struct frontend_regexp));
     fr->t = T_FR_STRING;
-    fr->d.STRING.s = strdup(s);
+    size_t len = strlen(s);
+    fr->d.STRING.s = malloc(len + 1);
+    memcpy(fr->d.STRING.s, s, len + 1);
     return fr;
 }
 
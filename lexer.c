@@ -1,60 +1,11 @@
 #include "lexer.h"
+#include "regexp_unicode.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-
-#define STRING_TOKEN_BASE 128
-static unsigned char next_string_token = STRING_TOKEN_BASE;
-static char** string_token_values = NULL;
-static int string_token_count = 0;
-
-static int find_string_token(const char* s) {
-    if (!s) return -1;
-    for (int i = 0; i < string_token_count; i++) {
-        if (strcmp(string_token_values[i], s) == 0) return i;
-    }
-    return -1;
-}
-
-void reset_string_token_table() {
-    for (int i = 0; i < string_token_count; i++) {
-        free(string_token_values[i]);
-    }
-    free(string_token_values);
-    string_token_values = NULL;
-    string_token_count = 0;
-    next_string_token = STRING_TOKEN_BASE;
-}
-
-unsigned char register_string_token(const char* s) {
-    if (!s) return 0;
-    int existing = find_string_token(s);
-    if (existing >= 0) {
-        return (unsigned char)(STRING_TOKEN_BASE + existing);
-    }
-    if (next_string_token == 0) { // overflow protection
-        return (unsigned char)255;
-    }
-    unsigned char token = next_string_token++;
-    char** resized = realloc(string_token_values, (string_token_count + 1) * sizeof(char*));
-    if (!resized) {
-        return token;
-    }
-    string_token_values = resized;
-    string_token_values[string_token_count] = strdup(s);
-    string_token_count++;
-    return token;
-}
-
-bool is_string_token_char(unsigned char token) {
-    int idx = (int)token - STRING_TOKEN_BASE;
-    return idx >= 0 && idx < string_token_count;
-}
-
-const char* get_string_token_label(unsigned char token) {
-    if (!is_string_token_char(token)) return NULL;
-    return string_token_values[(int)token - STRING_TOKEN_BASE];
-}
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 int char_in_set(char c, struct char_set* cs) {
     if (!cs || cs->n == 0) return 0;
@@ -120,6 +71,178 @@ void sort_state_set(StateSet* set) {
     }
 }
 
+// ==================== 字面量前缀树 ====================
+// 字符串按真实字节展开为单字符的连接；并集里的多个字面量分支（如 cat|car|"dog"）
+// 先合并成一棵共享前缀的 trie，再转回简化正则，避免每个关键字各自占一条 NFA 路径。
+struct literal_trie {
+    int terminal;
+    int num_children;
+    unsigned char* labels;
+    struct literal_trie** children;
+};
+
+static struct simpl_regexp* single_char_simpl(char c) {
+    struct char_set* cs = malloc(sizeof(struct char_set));
+    cs->n = 1;
+    cs->c = malloc(1);
+    cs->c[0] = c;
+    return TS_CharSet(cs);
+}
+
+static struct simpl_regexp* literal_to_simpl(const char* s, int len) {
+    if (len == 0) return TS_EmptyStr();
+    // 右结合地连接，保证 NFA 构造的递归深度只随长度线性增长
+    struct simpl_regexp* r = single_char_simpl(s[len - 1]);
+    for (int i = len - 2; i >= 0; i--) {
+        r = TS_Concat(single_char_simpl(s[i]), r);
+    }
+    return r;
+}
+
+// 返回字面量的字节数；fr 不是纯字面量时返回 -1
+static int literal_length(struct frontend_regexp* fr) {
+    switch (fr->t) {
+        case T_FR_STRING: return (int)strlen(fr->d.STRING.s);
+        case T_FR_SINGLE_CHAR: return 1;
+        case T_FR_CHAR_SET: return fr->d.CHAR_SET.n == 1 ? 1 : -1;
+        case T_FR_CONCAT: {
+            int l1 = literal_length(fr->d.CONCAT.r1);
+            int l2 = literal_length(fr->d.CONCAT.r2);
+            return (l1 < 0 || l2 < 0) ? -1 : l1 + l2;
+        }
+        default: return -1;
+    }
+}
+
+static int literal_bytes(struct frontend_regexp* fr, char* out) {
+    switch (fr->t) {
+        case T_FR_STRING: {
+            int len = (int)strlen(fr->d.STRING.s);
+            memcpy(out, fr->d.STRING.s, len);
+            return len;
+        }
+        case T_FR_SINGLE_CHAR: out[0] = fr->d.SINGLE_CHAR.c; return 1;
+        case T_FR_CHAR_SET: out[0] = fr->d.CHAR_SET.c[0]; return 1;
+        case T_FR_CONCAT: {
+            int l1 = literal_bytes(fr->d.CONCAT.r1, out);
+            return l1 + literal_bytes(fr->d.CONCAT.r2, out + l1);
+        }
+        default: return 0;
+    }
+}
+
+static void collect_union_alternatives(struct frontend_regexp* fr, struct frontend_regexp*** alts, int* n, int* cap) {
+    if (fr->t == T_FR_UNION) {
+        collect_union_alternatives(fr->d.UNION.r1, alts, n, cap);
+        collect_union_alternatives(fr->d.UNION.r2, alts, n, cap);
+        return;
+    }
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 8;
+        *alts = realloc(*alts, *cap * sizeof(struct frontend_regexp*));
+    }
+    (*alts)[(*n)++] = fr;
+}
+
+static struct literal_trie* create_trie_node() {
+    struct literal_trie* t = calloc(1, sizeof(struct literal_trie));
+    return t;
+}
+
+static void trie_insert(struct literal_trie* root, const char* s, int len) {
+    struct literal_trie* t = root;
+    for (int i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        struct literal_trie* next = NULL;
+        for (int k = 0; k < t->num_children; k++) {
+            if (t->labels[k] == c) { next = t->children[k]; break; }
+        }
+        if (!next) {
+            next = create_trie_node();
+            t->labels = realloc(t->labels, (t->num_children + 1) * sizeof(unsigned char));
+            t->children = realloc(t->children, (t->num_children + 1) * sizeof(struct literal_trie*));
+            t->labels[t->num_children] = c;
+            t->children[t->num_children] = next;
+            t->num_children++;
+        }
+        t = next;
+    }
+    t->terminal = 1;
+}
+
+static void free_trie(struct literal_trie* t) {
+    for (int k = 0; k < t->num_children; k++) free_trie(t->children[k]);
+    free(t->labels);
+    free(t->children);
+    free(t);
+}
+
+// 节点 t 之下所有后缀构成的简化正则（不含 t 自身的终结空串）
+static struct simpl_regexp* trie_to_simpl(struct literal_trie* t) {
+    struct simpl_regexp* alts = NULL;
+    // 只剩一个字符就结束的子结点合并成一个字符集，如 ca[tr]
+    char leaves[256];
+    int num_leaves = 0;
+    for (int k = 0; k < t->num_children; k++) {
+        struct literal_trie* child = t->children[k];
+        if (child->terminal && child->num_children == 0) leaves[num_leaves++] = (char)t->labels[k];
+    }
+    if (num_leaves > 0) alts = TS_CharSet(create_char_set_from_chars(leaves, num_leaves));
+    for (int k = 0; k < t->num_children; k++) {
+        struct literal_trie* child = t->children[k];
+        if (child->terminal && child->num_children == 0) continue;
+        struct simpl_regexp* rest = trie_to_simpl(child);
+        if (child->terminal) rest = TS_Union(rest, TS_EmptyStr());
+        struct simpl_regexp* branch = TS_Concat(single_char_simpl((char)t->labels[k]), rest);
+        alts = alts ? TS_Union(alts, branch) : branch;
+    }
+    return alts;
+}
+
+// 并集中至少有两个字面量分支时，把它们合并为前缀树，其余分支保持原有次序；
+// 否则返回 NULL，由调用者按普通并集处理
+static struct simpl_regexp* simplify_literal_union(struct frontend_regexp* fr) {
+    struct frontend_regexp** alts = NULL;
+    int n = 0, cap = 0;
+    collect_union_alternatives(fr, &alts, &n, &cap);
+    int num_literals = 0;
+    for (int i = 0; i < n; i++) {
+        if (literal_length(alts[i]) >= 0) num_literals++;
+    }
+    if (num_literals < 2) {
+        free(alts);
+        return NULL;
+    }
+    struct literal_trie* root = create_trie_node();
+    int trie_slot = -1;
+    for (int i = 0; i < n; i++) {
+        int len = literal_length(alts[i]);
+        if (len < 0) continue;
+        if (trie_slot < 0) trie_slot = i;
+        char* buf = malloc(len + 1);
+        literal_bytes(alts[i], buf);
+        trie_insert(root, buf, len);
+        free(buf);
+    }
+    struct simpl_regexp* result = NULL;
+    for (int i = 0; i < n; i++) {
+        struct simpl_regexp* r = NULL;
+        if (i == trie_slot) {
+            r = trie_to_simpl(root);
+            if (!r) r = TS_EmptyStr();
+            else if (root->terminal) r = TS_Union(r, TS_EmptyStr());
+        } else if (literal_length(alts[i]) < 0) {
+            r = simplify_regexp(alts[i]);
+        } else {
+            continue;
+        }
+        result = result ? TS_Union(result, r) : r;
+    }
+    free_trie(root);
+    free(alts);
+    return result;
+}
+
 // 简化正则表达式
 struct simpl_regexp* simplify_regexp(struct frontend_regexp* fr) {
     if (!fr) return NULL;
@@ -137,15 +260,7 @@ struct simpl_regexp* simplify_regexp(struct frontend_regexp* fr) {
             return TS_CharSet(cs);
         }
         case T_FR_STRING: {
-            char* s = fr->d.STRING.s;
-            int len = strlen(s);
-            if (len == 0) return TS_EmptyStr();
-            unsigned char token = register_string_token(s);
-            struct char_set* cs = malloc(sizeof(struct char_set));
-            cs->n = 1;
-            cs->c = malloc(1);
-            cs->c[0] = (char)token;
-            return TS_CharSet(cs);
+            return literal_to_simpl(fr->d.STRING.s, strlen(fr->d.STRING.s));
         }
         case T_FR_OPTIONAL: {
             struct simpl_regexp* r = simplify_regexp(fr->d.OPTION.r);
@@ -160,6 +275,8 @@ struct simpl_regexp* simplify_regexp(struct frontend_regexp* fr) {
             return TS_Concat(r, TS_Star(r));
         }
         case T_FR_UNION: {
+            struct simpl_regexp* merged = simplify_literal_union(fr);
+            if (merged) return merged;
             struct simpl_regexp* r1 = simplify_regexp(fr->d.UNION.r1);
             struct simpl_regexp* r2 = simplify_regexp(fr->d.UNION.r2);
             return TS_Union(r1, r2);
@@ -224,11 +341,16 @@ NFAFragment regexp_to_nfa_fragment(struct finite_automata* nfa, struct simpl_reg
     return frag;
 }
 
+// 构造出的 NFA 起点固定为 0、接受点固定为 n - 1，combine_nfas 依赖这一约定
 struct finite_automata* build_nfa_from_regexp(struct simpl_regexp* sr) {
     if (!sr) return NULL;
     struct finite_automata* nfa = create_empty_graph();
     if (!nfa) return NULL;
-    regexp_to_nfa_fragment(nfa, sr);
+    int start = add_one_vertex(nfa);
+    NFAFragment frag = regexp_to_nfa_fragment(nfa, sr);
+    int end = add_one_vertex(nfa);
+    add_one_edge(nfa, start, frag.start, NULL);
+    add_one_edge(nfa, frag.end, end, NULL);
     return nfa;
 }
 
@@ -301,119 +423,393 @@ StateSet* move(struct finite_automata* nfa, StateSet* set, char c) {
     return create_state_set(states, reach_count, -1);
 }
 
+// NFA 邻接索引：ε 边与字符边按起点分组（CSR），字符边标签展开为 256 位位图
+NFAIndex* build_nfa_index(struct finite_automata* nfa) {
+    NFAIndex* idx = malloc(sizeof(NFAIndex));
+    int n = nfa->n;
+    idx->n = n;
+    idx->eps_start = calloc(n + 1, sizeof(int));
+    idx->sym_start = calloc(n + 1, sizeof(int));
+    for (int e = 0; e < nfa->m; e++) {
+        if (nfa->lb[e].n == 0) idx->eps_start[nfa->src[e] + 1]++;
+        else idx->sym_start[nfa->src[e] + 1]++;
+    }
+    for (int v = 0; v < n; v++) {
+        idx->eps_start[v + 1] += idx->eps_start[v];
+        idx->sym_start[v + 1] += idx->sym_start[v];
+    }
+    idx->eps_dst = malloc((idx->eps_start[n] + 1) * sizeof(int));
+    idx->sym_dst = malloc((idx->sym_start[n] + 1) * sizeof(int));
+    idx->sym_bits = calloc(idx->sym_start[n] + 1, sizeof(*idx->sym_bits));
+    int* eps_fill = malloc((n + 1) * sizeof(int));
+    int* sym_fill = malloc((n + 1) * sizeof(int));
+    memcpy(eps_fill, idx->eps_start, (n + 1) * sizeof(int));
+    memcpy(sym_fill, idx->sym_start, (n + 1) * sizeof(int));
+    for (int e = 0; e < nfa->m; e++) {
+        int src = nfa->src[e];
+        if (nfa->lb[e].n == 0) {
+            idx->eps_dst[eps_fill[src]++] = nfa->dst[e];
+        } else {
+            int k = sym_fill[src]++;
+            idx->sym_dst[k] = nfa->dst[e];
+            for (unsigned int i = 0; i < nfa->lb[e].n; i++) {
+                unsigned char c = (unsigned char)nfa->lb[e].c[i];
+                idx->sym_bits[k][c >> 3] |= (unsigned char)(1u << (c & 7));
+            }
+        }
+    }
+    free(eps_fill);
+    free(sym_fill);
+    return idx;
+}
+
+void free_nfa_index(NFAIndex* idx) {
+    if (!idx) return;
+    free(idx->eps_start);
+    free(idx->eps_dst);
+    free(idx->sym_start);
+    free(idx->sym_dst);
+    free(idx->sym_bits);
+    free(idx);
+}
+
+// set[0..size) 为已用 stamp 标记过的种子，原地扩展为其 ε-闭包，返回闭包大小（set 容量需 >= n）
+int nfa_index_closure(NFAIndex* idx, int* set, int size, int* mark, int stamp) {
+    for (int i = 0; i < size; i++) {
+        int v = set[i];
+        for (int k = idx->eps_start[v]; k < idx->eps_start[v + 1]; k++) {
+            int w = idx->eps_dst[k];
+            if (mark[w] != stamp) {
+                mark[w] = stamp;
+                set[size++] = w;
+            }
+        }
+    }
+    return size;
+}
+
+// 把 256 个字节划分为等价类：在所有字符边上表现一致的字节归为一类，子集构造只需对每类算一次 move
+int compute_byte_classes(NFAIndex* idx, unsigned char* classes) {
+    int num_classes = 1;
+    int remap[512];
+    memset(classes, 0, 256);
+    for (int k = 0; k < idx->sym_start[idx->n]; k++) {
+        for (int i = 0; i < 2 * num_classes; i++) remap[i] = -1;
+        int next = 0;
+        for (int c = 0; c < 256; c++) {
+            int bit = (idx->sym_bits[k][c >> 3] >> (c & 7)) & 1;
+            int key = classes[c] * 2 + bit;
+            if (remap[key] < 0) remap[key] = next++;
+            classes[c] = (unsigned char)remap[key];
+        }
+        num_classes = next;
+    }
+    return num_classes;
+}
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned int hash_state_set(const int* states, int size) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < size; i++) {
+        h ^= (unsigned int)states[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 子集构造过程中已发现的 DFA 状态：有序的 NFA 状态集合 + 开放寻址哈希表
+typedef struct {
+    int** sets;
+    int* sizes;
+    int count;
+    int cap;
+    int* table;
+    int table_size;
+} DFAStateTable;
+
+static void grow_state_table(DFAStateTable* st) {
+    int new_size = st->table_size ? st->table_size * 2 : 256;
+    int* table = malloc(new_size * sizeof(int));
+    for (int i = 0; i < new_size; i++) table[i] = -1;
+    for (int id = 0; id < st->count; id++) {
+        unsigned int h = hash_state_set(st->sets[id], st->sizes[id]) & (new_size - 1);
+        while (table[h] != -1) h = (h + 1) & (new_size - 1);
+        table[h] = id;
+    }
+    free(st->table);
+    st->table = table;
+    st->table_size = new_size;
+}
+
+// 查找有序集合 states；不存在时以新编号插入并置 *is_new
+static int intern_state_set(DFAStateTable* st, const int* states, int size, int* is_new) {
+    if ((st->count + 1) * 2 > st->table_size) grow_state_table(st);
+    unsigned int h = hash_state_set(states, size) & (st->table_size - 1);
+    while (st->table[h] != -1) {
+        int id = st->table[h];
+        if (st->sizes[id] == size && memcmp(st->sets[id], states, size * sizeof(int)) == 0) {
+            *is_new = 0;
+            return id;
+        }
+        h = (h + 1) & (st->table_size - 1);
+    }
+    if (st->count == st->cap) {
+        st->cap = st->cap ? st->cap * 2 : 64;
+        st->sets = realloc(st->sets, st->cap * sizeof(int*));
+        st->sizes = realloc(st->sizes, st->cap * sizeof(int));
+    }
+    int id = st->count++;
+    st->sets[id] = malloc((size + 1) * sizeof(int));
+    memcpy(st->sets[id], states, size * sizeof(int));
+    st->sizes[id] = size;
+    st->table[h] = id;
+    *is_new = 1;
+    return id;
+}
+
+static void free_state_table(DFAStateTable* st) {
+    for (int i = 0; i < st->count; i++) free(st->sets[i]);
+    free(st->sets);
+    free(st->sizes);
+    free(st->table);
+}
+
+// 按目标状态把 256 个字节分组，每个 (src, dst) 只加一条边
+void add_grouped_edges(struct finite_automata* dfa, int src, const int* byte_target) {
+    int targets[256], counts[256], offsets[256];
+    int num_targets = 0;
+    int slot_of_byte[256];
+    for (int c = 0; c < 256; c++) {
+        slot_of_byte[c] = -1;
+        if (byte_target[c] < 0) continue;
+        int slot = -1;
+        for (int t = 0; t < num_targets; t++) {
+            if (targets[t] == byte_target[c]) { slot = t; break; }
+        }
+        if (slot < 0) {
+            slot = num_targets++;
+            targets[slot] = byte_target[c];
+            counts[slot] = 0;
+        }
+        counts[slot]++;
+        slot_of_byte[c] = slot;
+    }
+    char chars[256];
+    int pos = 0;
+    for (int t = 0; t < num_targets; t++) {
+        offsets[t] = pos;
+        pos += counts[t];
+    }
+    for (int c = 0; c < 256; c++) {
+        if (slot_of_byte[c] >= 0) chars[offsets[slot_of_byte[c]]++] = (char)c;
+    }
+    pos = 0;
+    for (int t = 0; t < num_targets; t++) {
+        struct char_set cs = { chars + pos, (unsigned int)counts[t] };
+        add_one_edge(dfa, src, targets[t], &cs);
+        pos += counts[t];
+    }
+}
+
 // NFA2DFA
-struct finite_automata* nfa_to_dfa(struct finite_automata* nfa, int* accepting_states, int num_accepting, int* dfa_accepting_rules) {
+// 起点为 NFA 的 0 号点；*dfa_accepting_rules 新分配，长度为 dfa->n，非接受态为 -1
+struct finite_automata* nfa_to_dfa(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules) {
+    return nfa_to_dfa_bounded(nfa, accepting_states, num_accepting, dfa_accepting_rules, 0, 0);
+}
+
+// NFA 点 -> 规则编号；同一个点对应多条规则时取靠前的
+int* build_accept_rule_map(struct finite_automata* nfa, int* accepting_states, int num_accepting) {
+    int* accept_rule_of = malloc((nfa->n + 1) * sizeof(int));
+    for (int v = 0; v < nfa->n; v++) accept_rule_of[v] = -1;
+    for (int k = 0; k < num_accepting; k++) {
+        if (accepting_states[k] >= 0 && accepting_states[k] < nfa->n && accept_rule_of[accepting_states[k]] == -1) {
+            accept_rule_of[accepting_states[k]] = k;
+        }
+    }
+    return accept_rule_of;
+}
+
+// 带预算的子集构造：状态数超过 max_states 或状态集合占用超过 max_memory 字节时放弃并返回 NULL（0 表示不限）
+struct finite_automata* nfa_to_dfa_bounded(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules, int max_states, size_t max_memory) {
+    return nfa_to_dfa_profiled(nfa, accepting_states, num_accepting, dfa_accepting_rules, max_states, max_memory, NULL);
+}
+
+// 同 nfa_to_dfa_bounded；report 非空时额外记录闭包次数、字节类数、状态数与状态集合内存
+struct finite_automata* nfa_to_dfa_profiled(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules, int max_states, size_t max_memory, struct LexerBuildReport* report) {
+    int start;
+    return nfa_to_dfa_modes(nfa, accepting_states, num_accepting, 1, dfa_accepting_rules, &start, max_states, max_memory, report);
+}
+
+// 多起点的子集构造：NFA 的 0 .. num_roots - 1 号点各是一个模式的起点，所有模式共用一张状态表，
+// 相同的状态集合只出现一次；start_states[m] 为模式 m 的起始状态，模式 0 的起始状态总是 0
+struct finite_automata* nfa_to_dfa_modes(struct finite_automata* nfa, int* accepting_states, int num_accepting, int num_roots, int** dfa_accepting_rules, int* start_states, int max_states, size_t max_memory, struct LexerBuildReport* report) {
     struct finite_automata* dfa = create_empty_graph();
     if (!dfa) return NULL;
-    // 初始化接受状态数组
-    for (int i = 0; i < 1000; i++) dfa_accepting_rules[i] = -1;
-    int start_closure_size;
-    int* start_states = get_epsilon_closure(nfa, 0, &start_closure_size);
-    StateSet* start_set = create_state_set(start_states, start_closure_size, 0);
-    sort_state_set(start_set);
-    free(start_states);
-    // 工作列表
-    StateSet** worklist = malloc(100 * sizeof(StateSet*));
-    StateSet** statesets = malloc(100 * sizeof(StateSet*));
-    int worklist_count = 0, stateset_count = 0;
-    // 添加起始状态
-    worklist[worklist_count++] = start_set;
-    statesets[stateset_count++] = start_set;
-    start_set->id = add_one_vertex(dfa);
-    // 字母表
-    struct char_set* alphabet = get_alphabet(nfa);
-    while (worklist_count > 0) {
-        StateSet* current = worklist[--worklist_count];
-        for (unsigned int ci = 0; ci < alphabet->n; ci++) {
-            char c = alphabet->c[ci];
-            StateSet* moved = move(nfa, current, c);
-            if (moved->size == 0) {
-                free_state_set(moved);
-                continue;
-            }
-            // 计算ε-闭包
-            bool* closure_visited = calloc(nfa->n, sizeof(bool));
-            int* closure_states = malloc(nfa->n * sizeof(int));
-            int closure_size = 0;
-            for (int i = 0; i < moved->size; i++) {
-                int* partial_closure;
-                int partial_size;
-                partial_closure = get_epsilon_closure(nfa, moved->states[i], &partial_size);
-                for (int j = 0; j < partial_size; j++) {
-                    if (!closure_visited[partial_closure[j]]) {
-                        closure_visited[partial_closure[j]] = true;
-                        closure_states[closure_size++] = partial_closure[j];
+    NFAIndex* idx = build_nfa_index(nfa);
+    unsigned char classes[256];
+    int num_classes = compute_byte_classes(idx, classes);
+    unsigned long long closure_calls = 0, closure_vertices = 0;
+    // 每个等价类取最小的字节作代表；不出现在任何边上的类直接跳过
+    int class_rep[256];
+    bool class_live[256] = {false};
+    for (int c = 255; c >= 0; c--) class_rep[classes[c]] = c;
+    for (int k = 0; k < idx->sym_start[idx->n]; k++) {
+        for (int c = 0; c < 256; c++) {
+            if ((idx->sym_bits[k][c >> 3] >> (c & 7)) & 1) class_live[classes[c]] = true;
+        }
+    }
+    int* accept_rule_of = build_accept_rule_map(nfa, accepting_states, num_accepting);
+
+    int* buf = malloc((nfa->n + 1) * sizeof(int));
+    int* mark = calloc(nfa->n + 1, sizeof(int));
+    int stamp = 1;
+    DFAStateTable st = {0};
+    int* worklist = NULL;
+    int worklist_count = 0, worklist_cap = 0;
+
+    // 各模式的起始状态，按模式编号依次放入工作表
+    int size = 0;
+    int is_new;
+    size_t memory = 0;
+    worklist_cap = 64;
+    while (worklist_cap < num_roots) worklist_cap *= 2;
+    worklist = malloc(worklist_cap * sizeof(int));
+    for (int r = 0; r < num_roots; r++) {
+        size = 0;
+        if (r < nfa->n) {
+            stamp++;
+            buf[size++] = r;
+            mark[r] = stamp;
+            size = nfa_index_closure(idx, buf, size, mark, stamp);
+            closure_calls++;
+            closure_vertices += size;
+        }
+        qsort(buf, size, sizeof(int), compare_ints);
+        start_states[r] = intern_state_set(&st, buf, size, &is_new);
+        if (!is_new) continue;
+        add_one_vertex(dfa);
+        memory += size * sizeof(int);
+        worklist[worklist_count++] = start_states[r];
+    }
+
+    int class_target[256];
+    int byte_target[256];
+    bool over_budget = false;
+    while (worklist_count > 0 && !over_budget) {
+        int current = worklist[--worklist_count];
+        for (int cls = 0; cls < num_classes; cls++) {
+            class_target[cls] = -1;
+            if (!class_live[cls]) continue;
+            int c = class_rep[cls];
+            stamp++;
+            size = 0;
+            // move：注意 st.sets 可能在插入时 realloc，每次重新取指针
+            for (int i = 0; i < st.sizes[current]; i++) {
+                int v = st.sets[current][i];
+                for (int k = idx->sym_start[v]; k < idx->sym_start[v + 1]; k++) {
+                    int w = idx->sym_dst[k];
+                    if (((idx->sym_bits[k][c >> 3] >> (c & 7)) & 1) && mark[w] != stamp) {
+                        mark[w] = stamp;
+                        buf[size++] = w;
                     }
                 }
-                free(partial_closure);
-            }
-            free_state_set(moved);
-            if (closure_size == 0) {
-                free(closure_visited);
-                free(closure_states);
-                continue;
             }
-            StateSet* new_set = create_state_set(closure_states, closure_size, -1);
-            sort_state_set(new_set);
-            free(closure_visited);
-            free(closure_states);
-            // 查找是否已存在
-            int found = -1;
-            for (int i = 0; i < stateset_count; i++) {
-                if (state_set_equal(new_set, statesets[i])) {
-                    found = statesets[i]->id;
-                    free_state_set(new_set);
+            if (size == 0) continue;
+            size = nfa_index_closure(idx, buf, size, mark, stamp);
+            closure_calls++;
+            closure_vertices += size;
+            qsort(buf, size, sizeof(int), compare_ints);
+            int id = intern_state_set(&st, buf, size, &is_new);
+            if (is_new) {
+                memory += size * sizeof(int) + sizeof(int*) + sizeof(int);
+                if ((max_states > 0 && st.count > max_states) || (max_memory > 0 && memory > max_memory)) {
+                    over_budget = true;
                     break;
                 }
-            }
-            if (found == -1) {
-                new_set->id = add_one_vertex(dfa);
-                worklist[worklist_count++] = new_set;
-                statesets[stateset_count++] = new_set;
-                found = new_set->id;
-            }
-            // 添加DFA边
-            struct char_set* single_char = malloc(sizeof(struct char_set));
-            single_char->n = 1;
-            single_char->c = malloc(1);
-            single_char->c[0] = c;
-            add_one_edge(dfa, current->id, found, single_char);
-        }
-    }
-    // 标记接受状态
-    for (int i = 0; i < stateset_count; i++) {
-        StateSet* set = statesets[i];
-        for (int j = 0; j < set->size; j++) {
-            for (int k = 0; k < num_accepting; k++) {
-                if (set->states[j] == accepting_states[k]) {
-                    dfa_accepting_rules[set->id] = k;
-                    break;
+                add_one_vertex(dfa);
+                if (worklist_count == worklist_cap) {
+                    worklist_cap *= 2;
+                    worklist = realloc(worklist, worklist_cap * sizeof(int));
                 }
+                worklist[worklist_count++] = id;
             }
+            class_target[cls] = id;
         }
+        if (over_budget) break;
+        for (int c = 0; c < 256; c++) byte_target[c] = class_target[classes[c]];
+        add_grouped_edges(dfa, current, byte_target);
+    }
+    if (report) {
+        report->closure_calls += closure_calls;
+        report->closure_vertices += closure_vertices;
+        report->byte_classes = num_classes;
+        report->alphabet_size = 0;
+        for (int cls = 0; cls < num_classes; cls++) report->alphabet_size += class_live[cls];
+        report->dfa_states = st.count;
+        report->dfa_edges = dfa->m;
+        report->dfa_set_memory = memory;
+        report->dfa_over_budget = over_budget;
+    }
+    if (over_budget) {
+        free_state_table(&st);
+        free(worklist);
+        free(buf);
+        free(mark);
+        free(accept_rule_of);
+        free_nfa_index(idx);
+        free_finite_automata(dfa);
+        *dfa_accepting_rules = NULL;
+        return NULL;
     }
+
+    // 标记接受状态：集合中编号最大的接受点决定规则
+    int* rules = malloc((st.count + 1) * sizeof(int));
+    for (int id = 0; id < st.count; id++) {
+        rules[id] = -1;
+        for (int i = 0; i < st.sizes[id]; i++) {
+            int r = accept_rule_of[st.sets[id][i]];
+            if (r != -1) rules[id] = r;
+        }
+    }
+    *dfa_accepting_rules = rules;
+
     // 清理
-    free(alphabet->c);
-    free(alphabet);
-    for (int i = 0; i < stateset_count; i++) free_state_set(statesets[i]);
-    free(statesets);
+    free_state_table(&st);
     free(worklist);
+    free(buf);
+    free(mark);
+    free(accept_rule_of);
+    free_nfa_index(idx);
     return dfa;
 }
 
 // 合并NFA
 struct finite_automata* combine_nfas(struct finite_automata** nfas, int num_nfas, int** accepting_states, int* num_accepting) {
+    return combine_nfas_modes(nfas, num_nfas, 1, NULL, accepting_states, num_accepting);
+}
+
+// 按模式合并：0 .. num_modes - 1 号点是各模式的起点，各自以 ε 边连向在该模式中有效的规则；
+// rule_modes[i] 的第 m 位表示规则 i 在模式 m 中有效，rule_modes 为 NULL 或某项为 0 表示所有模式
+struct finite_automata* combine_nfas_modes(struct finite_automata** nfas, int num_nfas, int num_modes, const unsigned int* rule_modes, int** accepting_states, int* num_accepting) {
     if (num_nfas == 0) return NULL;
     
     struct finite_automata* combined = create_empty_graph();
     *accepting_states = malloc(num_nfas * sizeof(int));
     *num_accepting = num_nfas;
     
-    int new_start = add_one_vertex(combined);
-    int state_offset = 1;
+    for (int m = 0; m < num_modes; m++) {
+        add_one_vertex(combined);
+    }
+    int state_offset = num_modes;
     
     for (int i = 0; i < num_nfas; i++) {
-        add_one_edge(combined, new_start, state_offset, NULL);
+        for (int m = 0; m < num_modes; m++) {
+            if (!rule_modes || !rule_modes[i] || ((rule_modes[i] >> m) & 1)) add_one_edge(combined, m, state_offset, NULL);
+        }
         
         for (int v = 0; v < nfas[i]->n; v++) {
             add_one_vertex(combined);
@@ -432,6 +828,20 @@ struct finite_automata* combine_nfas(struct finite_automata** nfas, int num_nfas
     return combined;
 }
 
+// 简化每条规则、分别构造 NFA 再合并；调用者负责释放返回的 NFA 与 *accepting_states
+struct finite_automata* build_combined_nfa(struct frontend_regexp** regexps, int num_regexps, int** accepting_states, int* num_accepting) {
+    struct finite_automata** nfas = malloc(num_regexps * sizeof(struct finite_automata*));
+    for (int i = 0; i < num_regexps; i++) {
+        nfas[i] = build_nfa_from_regexp(simplify_regexp(regexps[i]));
+    }
+    struct finite_automata* combined = combine_nfas(nfas, num_regexps, accepting_states, num_accepting);
+    for (int i = 0; i < num_regexps; i++) {
+        free_finite_automata(nfas[i]);
+    }
+    free(nfas);
+    return combined;
+}
+
 struct frontend_regexp* create_digit_regex() {
     struct char_set* digit_set = create_char_set_from_range('0', '9');
     return TFr_CharSet(digit_set);
@@ -516,57 +926,67 @@ struct frontend_regexp* create_symbol_regex() {
 
 // 词法分析
 void lexical_analysis(struct finite_automata* dfa, int* dfa_accepting_rules, char* input, int* segments, int* categories) {
-    int pos = 0, input_len = strlen(input), segment_count = 0;
-    int current_state = 0, last_accepting_state = -1, last_accepting_pos = -1, start_pos = 0;
-    
-    while (pos <= input_len) {
-        if (current_state != -1 && dfa_accepting_rules[current_state] != -1) {
-            last_accepting_state = current_state;
-            last_accepting_pos = pos;
-        }
-        
-        if (pos < input_len) {
-            int next_state = -1;
-            char current_char = input[pos];
-            
-            for (int e = 0; e < dfa->m; e++) {
-                if (dfa->src[e] == current_state && dfa->lb[e].n > 0 && char_in_set(current_char, &dfa->lb[e])) {
-                    next_state = dfa->dst[e];
-                    break;
-                }
-            }
-            
-            if (next_state != -1) {
-                current_state = next_state;
-                pos++;
-            } else {
-                if (last_accepting_state != -1) {
-                    segments[segment_count] = start_pos;
-                    categories[segment_count] = dfa_accepting_rules[last_accepting_state];
-                    segment_count++;
-                    start_pos = last_accepting_pos;
-                    pos = last_accepting_pos;
-                    current_state = 0;
-                    last_accepting_state = -1;
-                } else {
-                    segments[segment_count] = start_pos;
-                    categories[segment_count] = -1;
-                    segment_count++;
-                    start_pos = pos + 1;
-                    pos++;
-                    current_state = 0;
-                }
-            }
-        } else {
-            if (last_accepting_state != -1) {
-                segments[segment_count] = start_pos;
-                categories[segment_count] = dfa_accepting_rules[last_accepting_state];
-                segment_count++;
-            }
-            break;
+    lexical_analysis_with_stats(dfa, dfa_accepting_rules, input, segments, categories, NULL);
+}
+
+// 边表 DFA 的最长匹配游标，逐边查找转移；stats 只在以 LEXER_STATS 编译时被更新，否则 LEXER_STAT 展开为空
+typedef struct {
+    struct finite_automata* dfa;
+    int* accepting_rules;
+    int state;
+    struct LexerStats* stats;
+} EdgeCursor;
+
+static inline void edge_reset(void* ctx) {
+    ((EdgeCursor*)ctx)->state = 0;
+}
+
+static inline int edge_step(void* ctx, unsigned char c) {
+    EdgeCursor* cur = ctx;
+    struct finite_automata* dfa = cur->dfa;
+    LEXER_STAT(cur->stats, cur->stats->transitions++; if (cur->state < cur->stats->num_states) cur->stats->state_visits[cur->state]++);
+    for (int e = 0; e < dfa->m; e++) {
+        if (dfa->src[e] == cur->state && dfa->lb[e].n > 0 && char_in_set((char)c, &dfa->lb[e])) {
+            cur->state = dfa->dst[e];
+            return 1;
         }
     }
-    
+    return 0;
+}
+
+static inline int edge_accept(void* ctx) {
+    EdgeCursor* cur = ctx;
+    return cur->accepting_rules[cur->state];
+}
+
+static const LexMunchOps edge_ops = { edge_reset, edge_step, edge_accept };
+
+// 切出一个单元后的统计；回退的字节数是匹配时读过最长匹配终点的部分
+static void count_unit(struct LexerStats* stats, const struct LexMunch* m) {
+    (void)stats;
+    (void)m;
+    LEXER_STAT(stats,
+        unsigned long long back = m->rule != -1 ? (unsigned long long)(m->scan_end - m->offset - m->length) : 0;
+        lexer_stats_count_token(stats, m->rule, m->length);
+        if (back > 0) { stats->backtracks++; stats->backtrack_bytes += back; }
+        if (back > stats->max_backtrack) stats->max_backtrack = back);
+}
+
+void lexical_analysis_with_stats(struct finite_automata* dfa, int* dfa_accepting_rules, char* input, int* segments, int* categories, struct LexerStats* stats) {
+    EdgeCursor cur = { dfa, dfa_accepting_rules, 0, stats };
+    struct LexMunch m;
+    int input_len = strlen(input), segment_count = 0;
+    (void)stats;
+    LEXER_STAT(stats, stats->calls++; stats->bytes_processed += input_len);
+
+    lex_munch_init(&m, 0);
+    while (lex_munch(&edge_ops, &cur, &m, (const unsigned char*)input, input_len, 1) == LEX_MUNCH_UNIT) {
+        segments[segment_count] = m.offset;
+        categories[segment_count] = m.rule;
+        segment_count++;
+        count_unit(stats, &m);
+    }
+
     segments[segment_count] = -1;
     categories[segment_count] = -1;
 }
@@ -623,48 +1043,467 @@ struct frontend_regexp** create_default_rules(int* num_rules) {
 }
 
 
+// 记录从上一个时间点 t 到现在的耗时到 report->field，并把 t 推进到现在
+#define PROFILE_PHASE(report, t, field) do { \
+        if (report) { double now_ = lexer_profile_now_ms(); (report)->field += now_ - (t); (t) = now_; } \
+    } while (0)
+
+// 表的状态重新编号后，各模式的起始状态随之改号
+static void renumber_mode_starts(struct Lexer* lexer, const int* renumber) {
+    for (int m = 0; lexer->mode_starts && m < lexer->num_modes; m++) {
+        lexer->mode_starts[m] = renumber[lexer->mode_starts[m]];
+    }
+}
+
+// DFA 及其接受规则交给 lexer，并按 options 构造查表用的稠密表或压缩表；lexer->mode_starts 按 dfa 的编号给出
+static void attach_dfa(struct Lexer* lexer, struct finite_automata* dfa, int* dfa_accepting_rules, struct LexerOptions* options) {
+    int* renumber = lexer->mode_starts ? malloc(dfa->n * sizeof(int)) : NULL;
+    if (options && options->table == LEXER_TABLE_COMB) {
+        // 压缩表由 BFS 编号的稠密表转换而来，稠密表只是临时的
+        struct DFATable* dense = build_dfa_table(dfa, dfa_accepting_rules);
+        reorder_dfa_table_tracked(dense, NULL, renumber);
+        lexer->comb = build_comb_table(dense);
+        free_dfa_table(dense);
+        if (renumber) renumber_mode_starts(lexer, renumber);
+    } else if (dfa->n <= LEXER_DENSE_TABLE_MAX_STATES) {
+        lexer->table = build_dfa_table(dfa, dfa_accepting_rules);
+        reorder_dfa_table_tracked(lexer->table, NULL, renumber);
+        if (renumber) renumber_mode_starts(lexer, renumber);
+    }
+    free(renumber);
+    lexer->dfa = dfa;
+    lexer->dfa_accepting_rules = dfa_accepting_rules;
+    lexer->dfa_size = dfa->n;
+#ifdef LEXER_STATS
+    lexer->stats = create_lexer_stats(lexer->num_rules, dfa->n);
+#endif
+}
+
+// 找一个形如 [S]+ 的跳过规则：S 是起始状态（模式 0）读入后到达同一状态 q 的字节，
+// 从 q 只读 S 中字节能到达的状态（DFA 未最小化，通常是两三个）都接受不切换模式的跳过规则，并且读 S 以外的字节即死
+static void find_skip_run(struct Lexer* lexer) {
+    struct LexSkipRun* run = &lexer->skip_run;
+    run->state = -1;
+    if (lexer->engine != LEXER_ENGINE_DFA || !lexer->skip_rules) return;
+    int best = 0;
+    int target[256], closure[LEXER_SKIP_RUN_MAX_STATES];
+    unsigned char member[256];
+    for (int c = 0; c < 256; c++) target[c] = lexer_dfa_step(lexer, 0, (unsigned char)c);
+    for (int c = 0; c < 256; c++) {
+        int q = target[c];
+        if (q <= 0) continue;
+        int count = 0;
+        for (int b = 0; b < 256; b++) {
+            member[b] = target[b] == q;
+            count += member[b];
+        }
+        if (count <= best) continue;
+        int num_states = 1, ok = 1;
+        closure[0] = q;
+        for (int k = 0; k < num_states && ok; k++) {
+            int rule = lexer_dfa_accept(lexer, closure[k]);
+            ok = rule >= 0 && lexer->skip_rules[rule] && lexer_next_mode(lexer, rule, -1) == -1;
+            for (int b = 0; b < 256 && ok; b++) {
+                int next = lexer_dfa_step(lexer, closure[k], (unsigned char)b);
+                if (!member[b]) {
+                    ok = next == -1;
+                    continue;
+                }
+                int seen = next == -1 ? -1 : 0;
+                for (int m = 0; m < num_states && seen == 0; m++) seen = closure[m] == next;
+                if (seen == -1 || (!seen && num_states == LEXER_SKIP_RUN_MAX_STATES)) ok = 0;
+                else if (!seen) closure[num_states++] = next;
+            }
+        }
+        if (!ok) continue;
+        best = count;
+        run->state = q;
+        run->num_bytes = 0;
+        for (int b = 0; b < 256; b++) {
+            run->member[b] = member[b];
+            if (member[b]) run->bytes[run->num_bytes++] = (unsigned char)b;
+        }
+    }
+}
+
+// 关键字表、跳过规则与切换模式的规则在生成词法分析器时一次性构造好
+static void build_rule_keyword_tables(struct Lexer* lexer, struct LexerOptions* options) {
+    lexer->keyword_tables = calloc(lexer->num_rules, sizeof(struct KeywordTable*));
+    for (int i = 0; options && options->rule_attrs && i < lexer->num_rules; i++) {
+        struct LexerRuleAttr* attr = &options->rule_attrs[i];
+        if (attr->keywords && attr->num_keywords > 0) {
+            lexer->keyword_tables[i] = build_keyword_table(attr->keywords, attr->keyword_categories, attr->num_keywords);
+        }
+        if (attr->action == LEXER_ACTION_SKIP) {
+            if (!lexer->skip_rules) lexer->skip_rules = calloc(lexer->num_rules, 1);
+            lexer->skip_rules[i] = 1;
+        }
+        if (attr->switch_mode && attr->next_mode >= 0 && attr->next_mode < lexer->num_modes) {
+            if (!lexer->rule_next_mode) {
+                lexer->rule_next_mode = malloc(lexer->num_rules * sizeof(int));
+                for (int r = 0; r < lexer->num_rules; r++) lexer->rule_next_mode[r] = -1;
+            }
+            lexer->rule_next_mode[i] = attr->next_mode;
+        }
+    }
+    find_skip_run(lexer);
+}
+
+// 用已经构造好的 DFA 组装词法分析器，dfa 与 dfa_accepting_rules 的所有权转移给 lexer
+struct Lexer* lexer_from_dfa(struct finite_automata* dfa, int* dfa_accepting_rules, int num_rules, struct LexerOptions* options) {
+    struct Lexer* lexer = calloc(1, sizeof(struct Lexer));
+    lexer->num_rules = num_rules;
+    lexer->num_modes = 1;
+    lexer->engine = LEXER_ENGINE_DFA;
+    attach_dfa(lexer, dfa, dfa_accepting_rules, options);
+    build_rule_keyword_tables(lexer, options);
+    return lexer;
+}
+
 // 修复后的 generate_lexer 函数 - 关键修复！
 struct Lexer* generate_lexer(struct frontend_regexp** regexps, int num_regexps) {
+    return generate_lexer_with_options(regexps, num_regexps, NULL);
+}
+
+struct Lexer* generate_lexer_with_options(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options) {
+    struct LexerBuildReport* report = options ? options->report : NULL;
+    double t_begin = 0, t = 0;
+    if (report) {
+        memset(report, 0, sizeof(*report));
+        report->num_rules = num_regexps;
+        t_begin = t = lexer_profile_now_ms();
+    }
+    enum LexerEngine requested = options ? options->engine : LEXER_ENGINE_DFA;
+    // 多个模式只能由多起点的子集构造得到，不走逐规则编译、位并行与并行确定化
+    int num_modes = (options && options->num_modes > 1) ? options->num_modes : 1;
+    if (num_modes > LEXER_MAX_MODES) num_modes = LEXER_MAX_MODES;
+    // 逐规则编译时各规则在工作线程里自行简化，这里只在退回整体构造时才需要
+    bool per_rule = options && options->rule_cache && requested == LEXER_ENGINE_DFA && num_modes == 1;
+    // 不区分大小写的规则换成折叠后的副本，构造结束后释放
+    struct frontend_regexp** original = regexps;
+    struct frontend_regexp** folded = fold_rule_cases(regexps, num_regexps, options);
+    if (folded) regexps = folded;
+
     // 直接使用传入的规则，不要额外添加
     // 简化正则表达式
     struct simpl_regexp** simplified = malloc(num_regexps * sizeof(struct simpl_regexp*));
-    for (int i = 0; i < num_regexps; i++) {
+    for (int i = 0; !per_rule && i < num_regexps; i++) {
         simplified[i] = simplify_regexp(regexps[i]);
     }
+    PROFILE_PHASE(report, t, simplify_ms);
     
-    // 构建NFA
-    struct finite_automata** nfas = malloc(num_regexps * sizeof(struct finite_automata*));
-    for (int i = 0; i < num_regexps; i++) {
-        nfas[i] = build_nfa_from_regexp(simplified[i]);
+    struct Lexer* lexer = calloc(1, sizeof(struct Lexer));
+    lexer->num_rules = num_regexps;
+    lexer->num_modes = num_modes;
+
+    // 位并行引擎直接由简化正则构造，无需 NFA / DFA；位置数超过 64 时退回 DFA
+    if (requested == LEXER_ENGINE_SHIFT_AND && num_modes == 1) {
+        lexer->shift_and = build_shift_and(simplified, num_regexps);
+        PROFILE_PHASE(report, t, shift_and_ms);
     }
-    
-    // 合并NFA并转换为DFA
-    int* nfa_accepting_states;
-    int num_accepting;
-    struct finite_automata* combined_nfa = combine_nfas(nfas, num_regexps, &nfa_accepting_states, &num_accepting);
-    
-    int* dfa_accepting_rules = malloc(1000 * sizeof(int));
-    struct finite_automata* dfa = nfa_to_dfa(combined_nfa, nfa_accepting_states, num_accepting, dfa_accepting_rules);
-    
-    struct Lexer* lexer = malloc(sizeof(struct Lexer));
-    lexer->dfa = dfa;
-    lexer->dfa_accepting_rules = dfa_accepting_rules;
-    lexer->dfa_size = dfa->n;
-    
-    // 清理临时内存
-    for (int i = 0; i < num_regexps; i++) {
-        // 需要实现相应的free函数
+    if (lexer->shift_and) {
+        lexer->engine = LEXER_ENGINE_SHIFT_AND;
+    } else {
+        // 确定化有预算，超出时改用 NFA 模拟，保证不可信规则的编译时间有界
+        int max_states = (options && options->max_dfa_states) ? options->max_dfa_states : LEXER_DEFAULT_MAX_DFA_STATES;
+        size_t max_memory = (options && options->max_dfa_memory) ? options->max_dfa_memory : LEXER_DEFAULT_MAX_DFA_MEMORY;
+        int num_threads = options ? options->num_threads : 0;
+        int* dfa_accepting_rules = NULL;
+        struct finite_automata* dfa = NULL;
+        bool determinize = requested != LEXER_ENGINE_NFA;
+
+        // 逐规则编译并缓存，再做乘积合并；超出预算时整体构造同样会超出，直接退回 NFA 模拟
+        if (per_rule) {
+            dfa = build_product_dfa(regexps, num_regexps, options->rule_cache, num_threads, options->rule_ids,
+                                    options->product_memo, max_states, max_memory, &dfa_accepting_rules);
+            determinize = false;
+            if (report) {
+                report->dfa_states = dfa ? dfa->n : 0;
+                report->dfa_edges = dfa ? dfa->m : 0;
+                report->dfa_over_budget = !dfa;
+            }
+            PROFILE_PHASE(report, t, dfa_ms);
+        }
+
+        struct finite_automata** nfas = NULL;
+        struct finite_automata* combined_nfa = NULL;
+        int* nfa_accepting_states = NULL;
+        int num_accepting = 0;
+        if (!dfa) {
+            for (int i = 0; per_rule && i < num_regexps; i++) {
+                simplified[i] = simplify_regexp(regexps[i]);
+            }
+            PROFILE_PHASE(report, t, simplify_ms);
+
+            // 构建NFA
+            nfas = malloc(num_regexps * sizeof(struct finite_automata*));
+            for (int i = 0; i < num_regexps; i++) {
+                nfas[i] = build_nfa_from_regexp(simplified[i]);
+            }
+            PROFILE_PHASE(report, t, nfa_build_ms);
+
+            // 合并NFA并转换为DFA；每个模式一个起点，只连向在该模式中有效的规则
+            unsigned int* rule_modes = NULL;
+            if (num_modes > 1 && options->rule_attrs) {
+                rule_modes = malloc(num_regexps * sizeof(unsigned int));
+                for (int i = 0; i < num_regexps; i++) rule_modes[i] = options->rule_attrs[i].modes;
+            }
+            combined_nfa = combine_nfas_modes(nfas, num_regexps, num_modes, rule_modes, &nfa_accepting_states, &num_accepting);
+            free(rule_modes);
+            PROFILE_PHASE(report, t, combine_ms);
+            if (report) {
+                report->nfa_vertices = combined_nfa->n;
+                report->nfa_edges = combined_nfa->m;
+                for (int e = 0; e < combined_nfa->m; e++) report->nfa_epsilon_edges += combined_nfa->lb[e].n == 0;
+            }
+        }
+        if (determinize && num_modes > 1) {
+            lexer->mode_starts = malloc(num_modes * sizeof(int));
+            dfa = nfa_to_dfa_modes(combined_nfa, nfa_accepting_states, num_accepting, num_modes, &dfa_accepting_rules, lexer->mode_starts,
+                                   max_states, max_memory, report);
+            if (!dfa) {
+                free(lexer->mode_starts);
+                lexer->mode_starts = NULL;
+            }
+            PROFILE_PHASE(report, t, dfa_ms);
+        } else if (determinize) {
+            dfa = nfa_to_dfa_parallel(combined_nfa, nfa_accepting_states, num_accepting, &dfa_accepting_rules, max_states, max_memory, num_threads, report);
+            PROFILE_PHASE(report, t, dfa_ms);
+        }
+        if (dfa) attach_dfa(lexer, dfa, dfa_accepting_rules, options);
+        if (report) report->table_memory = lexer->comb ? comb_table_memory(lexer->comb) : lexer->table ? dfa_table_memory(lexer->table) : 0;
+        PROFILE_PHASE(report, t, dfa_ms);
+
+        lexer->engine = dfa ? LEXER_ENGINE_DFA : LEXER_ENGINE_NFA;
+        if (!dfa) {
+            lexer->nfa = combined_nfa;
+            lexer->nfa_index = build_nfa_index(combined_nfa);
+            lexer->nfa_accept_rules = build_accept_rule_map(combined_nfa, nfa_accepting_states, num_accepting);
+            combined_nfa = NULL;
+            PROFILE_PHASE(report, t, nfa_fallback_ms);
+        }
+
+        // 清理临时内存
+        for (int i = 0; nfas && i < num_regexps; i++) {
+            free_finite_automata(nfas[i]);
+        }
+        free_finite_automata(combined_nfa);
+        free(nfas);
+        free(nfa_accepting_states);
     }
+
+    build_rule_keyword_tables(lexer, options);
     free(simplified);
-    free(nfas);
-    free(nfa_accepting_states);
-    
+    free_folded_rules(folded, original, num_regexps);
+    PROFILE_PHASE(report, t, keyword_ms);
+    if (report) {
+        report->total_ms = t - t_begin;
+        report->peak_rss = lexer_profile_peak_rss();
+    }
+
     return lexer;
 }
 
+// 按引擎切分，categories 为 DFA 的规则编号，尚未按关键字表改判
+static void tokenize_rules(struct Lexer* lexer, char* input, int* segments, int* categories) {
+    if (lexer->engine == LEXER_ENGINE_NFA) {
+        nfa_lexical_analysis(lexer->nfa_index, lexer->nfa_accept_rules, input, segments, categories);
+    } else if (lexer->engine == LEXER_ENGINE_SHIFT_AND) {
+        shift_and_lexical_analysis(lexer->shift_and, input, segments, categories);
+    } else if (lexer->table && !lexer->stats) {
+        table_lexical_analysis(lexer->table, input, segments, categories);
+    } else if (lexer->comb && !lexer->stats) {
+        comb_lexical_analysis(lexer->comb, input, segments, categories);
+    } else {
+        lexical_analysis_with_stats(lexer->dfa, lexer->dfa_accepting_rules, input, segments, categories, lexer->stats);
+    }
+}
+
+// 运行 DFA 后，对声明了关键字表的规则按词素重新归类；不切换模式，始终按模式 0 切分
+void lexer_tokenize(struct Lexer* lexer, char* input, int* segments, int* categories) {
+    tokenize_rules(lexer, input, segments, categories);
+    int input_len = strlen(input);
+    for (int i = 0; segments[i] != -1; i++) {
+        int rule = categories[i];
+        if (rule < 0 || rule >= lexer->num_rules || !lexer->keyword_tables[rule]) continue;
+        int end = (segments[i + 1] != -1) ? segments[i + 1] : input_len;
+        int keyword = keyword_table_lookup(lexer->keyword_tables[rule], input + segments[i], end - segments[i]);
+        if (keyword != -1) categories[i] = keyword;
+    }
+}
+
+// 跳过段的终点：第一个不属于 run 的字节
+static int skip_run_end(const struct LexSkipRun* run, const char* input, int pos, int len) {
+#if defined(__SSE2__)
+    if (run->num_bytes <= 8) {
+        __m128i bytes[8];
+        for (int k = 0; k < run->num_bytes; k++) bytes[k] = _mm_set1_epi8((char)run->bytes[k]);
+        for (; pos + 16 <= len; pos += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i*)(input + pos));
+            __m128i hit = _mm_setzero_si128();
+            for (int k = 0; k < run->num_bytes; k++) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, bytes[k]));
+            unsigned int miss = ~(unsigned int)_mm_movemask_epi8(hit) & 0xFFFF;
+            if (miss) return pos + __builtin_ctz(miss);
+        }
+    }
+#endif
+    while (pos < len && run->member[(unsigned char)input[pos]]) pos++;
+    return pos;
+}
+
+// 写出一个单元：跳过规则的单元直接丢弃，其余按关键字表改判类别
+static inline int put_token(struct Lexer* lexer, const char* input, LexToken* tokens, int count, int start, int length, int rule) {
+    if (rule >= 0 && lexer->skip_rules && lexer->skip_rules[rule]) return count;
+    if (rule >= 0 && rule < lexer->num_rules && lexer->keyword_tables[rule]) {
+        int keyword = keyword_table_lookup(lexer->keyword_tables[rule], input + start, length);
+        if (keyword != -1) rule = keyword;
+    }
+    tokens[count].offset = start;
+    tokens[count].length = length;
+    tokens[count].rule = rule;
+    return count + 1;
+}
+
+// 按 lexer_munch.h 的驱动切分，输出带长度的 LexToken，跳过规则的单元在循环里就丢掉；
+// 每个单元从当前模式的起始状态开始匹配，匹配到切换模式的规则后换到它的目标模式
+static int dfa_scan_tokens(struct Lexer* lexer, const char* input, int len, LexToken* tokens, int* mode) {
+    const struct LexSkipRun* run = &lexer->skip_run;
+    struct LexDFACursor cur = { lexer, lexer_mode_start(lexer, *mode), 0 };
+    struct LexMunch m;
+    int count = 0;
+    lex_munch_init(&m, 0);
+    while (1) {
+        if (run->state != -1 && cur.start == 0 && m.pos < len && run->member[(unsigned char)input[m.pos]]) {
+            m.pos = skip_run_end(run, input, m.pos, len);
+            if (m.pos == len) break;
+        }
+        if (lexer_dfa_munch(&cur, &m, input, len, 1) != LEX_MUNCH_UNIT) break;
+        count = put_token(lexer, input, tokens, count, m.offset, m.length, m.rule);
+        if (lexer->rule_next_mode) {
+            *mode = lexer_next_mode(lexer, m.rule, *mode);
+            cur.start = lexer_mode_start(lexer, *mode);
+        }
+    }
+    return count;
+}
+
+// 其他引擎（以及需要统计的 DFA）没有各个模式的起始状态，只按模式 0 切分，同样在原缓冲区上逐个单元输出
+static int engine_scan_tokens(struct Lexer* lexer, const char* input, int len, LexToken* tokens) {
+    struct LexMunch m;
+    int count = 0;
+    lex_munch_init(&m, 0);
+    if (lexer->engine == LEXER_ENGINE_NFA) {
+        struct NFACursor cur;
+        nfa_cursor_init(&cur, lexer->nfa_index, lexer->nfa_accept_rules);
+        while (nfa_munch(&cur, &m, input, len, 1) == LEX_MUNCH_UNIT) count = put_token(lexer, input, tokens, count, m.offset, m.length, m.rule);
+        nfa_cursor_free(&cur);
+    } else if (lexer->engine == LEXER_ENGINE_SHIFT_AND) {
+        struct ShiftAndCursor cur = { lexer->shift_and, 0, 1 };
+        while (shift_and_munch(&cur, &m, input, len, 1) == LEX_MUNCH_UNIT) count = put_token(lexer, input, tokens, count, m.offset, m.length, m.rule);
+    } else {
+        EdgeCursor cur = { lexer->dfa, lexer->dfa_accepting_rules, 0, lexer->stats };
+        LEXER_STAT(lexer->stats, lexer->stats->calls++; lexer->stats->bytes_processed += len);
+        while (lex_munch(&edge_ops, &cur, &m, (const unsigned char*)input, len, 1) == LEX_MUNCH_UNIT) {
+            count_unit(lexer->stats, &m);
+            count = put_token(lexer, input, tokens, count, m.offset, m.length, m.rule);
+        }
+    }
+    return count;
+}
+
+static int scan_tokens(struct Lexer* lexer, const char* input, int len, LexToken* tokens, int* mode) {
+    if (lexer->mode_starts || (lexer->engine == LEXER_ENGINE_DFA && !lexer->stats)) return dfa_scan_tokens(lexer, input, len, tokens, mode);
+    // 多个模式需要 DFA 的各个起始状态，确定化超出预算时无法按模式切分
+    if (lexer->num_modes > 1) return -1;
+    return engine_scan_tokens(lexer, input, len, tokens);
+}
+
+int lexer_scan_tokens(struct Lexer* lexer, const char* input, LexToken* tokens) {
+    int mode = 0;
+    return scan_tokens(lexer, input, strlen(input), tokens, &mode);
+}
+
+int lexer_scan_tokens_in_mode(struct Lexer* lexer, const char* input, LexToken* tokens, int* mode) {
+    return scan_tokens(lexer, input, strlen(input), tokens, mode);
+}
+
+// 按长度分析，输入不必以 '\0' 结尾，中间的 '\0' 也照常切分；所有引擎都直接在原缓冲区上扫描，NFA 引擎只分配状态集合的工作区
+int lexer_scan_tokens_n(struct Lexer* lexer, const char* input, int len, LexToken* tokens) {
+    int mode = 0;
+    return scan_tokens(lexer, input, len, tokens, &mode);
+}
+
+// 用训练语料统计每个状态的访问次数，按热度重新排列稠密表的行；corpus 为空时退回 BFS 顺序
+void lexer_reorder_states(struct Lexer* lexer, char** corpus, int num_inputs) {
+    if (!lexer->table) return;
+    int* renumber = lexer->mode_starts ? malloc(lexer->table->num_states * sizeof(int)) : NULL;
+    if (!corpus || num_inputs <= 0) {
+        reorder_dfa_table_tracked(lexer->table, NULL, renumber);
+    } else {
+        unsigned long long* visits = calloc(lexer->table->num_states + 1, sizeof(unsigned long long));
+        for (int i = 0; i < num_inputs; i++) {
+            dfa_table_count_visits(lexer->table, corpus[i], visits);
+        }
+        reorder_dfa_table_tracked(lexer->table, visits, renumber);
+        free(visits);
+    }
+    if (renumber) renumber_mode_starts(lexer, renumber);
+    free(renumber);
+}
+
 void run_lexer(struct Lexer* lexer, char* input) {
     int segments[1000];
     int categories[1000];
-    lexical_analysis(lexer->dfa, lexer->dfa_accepting_rules, input, segments, categories);
+    lexer_tokenize(lexer, input, segments, categories);
     print_lexical_result(input, segments, categories);
 }
+
+// 内存释放
+void free_frontend_regexp(struct frontend_regexp* fr) {
+    if (!fr) return;
+    switch (fr->t) {
+        case T_FR_CHAR_SET: free(fr->d.CHAR_SET.c); break;
+        case T_FR_STRING: free(fr->d.STRING.s); break;
+        case T_FR_OPTIONAL: free_frontend_regexp(fr->d.OPTION.r); break;
+        case T_FR_STAR: free_frontend_regexp(fr->d.STAR.r); break;
+        case T_FR_PLUS: free_frontend_regexp(fr->d.PLUS.r); break;
+        case T_FR_UNION:
+            free_frontend_regexp(fr->d.UNION.r1);
+            free_frontend_regexp(fr->d.UNION.r2);
+            break;
+        case T_FR_CONCAT:
+            free_frontend_regexp(fr->d.CONCAT.r1);
+            free_frontend_regexp(fr->d.CONCAT.r2);
+            break;
+        case T_FR_SINGLE_CHAR: break;
+    }
+    free(fr);
+}
+
+void free_finite_automata(struct finite_automata* fa) {
+    if (!fa) return;
+    for (int e = 0; e < fa->m; e++) free(fa->lb[e].c);
+    free(fa->src);
+    free(fa->dst);
+    free(fa->lb);
+    free(fa);
+}
+
+void free_lexer(struct Lexer* lexer) {
+    if (!lexer) return;
+    free_finite_automata(lexer->dfa);
+    free(lexer->dfa_accepting_rules);
+    free_finite_automata(lexer->nfa);
+    free_nfa_index(lexer->nfa_index);
+    free(lexer->nfa_accept_rules);
+    free_shift_and(lexer->shift_and);
+    free_dfa_table(lexer->table);
+    free_comb_table(lexer->comb);
+    free_lexer_stats(lexer->stats);
+    for (int i = 0; i < lexer->num_rules; i++) free_keyword_table(lexer->keyword_tables[i]);
+    free(lexer->keyword_tables);
+    free(lexer->skip_rules);
+    free(lexer->mode_starts);
+    free(lexer->rule_next_mode);
+    free(lexer);
+}
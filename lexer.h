@@ -2,6 +2,14 @@
 #define LEXER_H_INCLUDED
 
 #include "lang.h"
+#include "keyword_hash.h"
+#include "shift_and.h"
+#include "dfa_table.h"
+#include "comb_table.h"
+#include "rule_dfa.h"
+#include "lexer_stats.h"
+#include "lexer_profile.h"
+#include "lexer_munch.h"
 #include <stdbool.h>
 
 typedef struct {
@@ -15,16 +23,109 @@ typedef struct {
     int end;
 } NFAFragment;
 
-// ==================== 字符串标签支持 ====================
-void reset_string_token_table();
-unsigned char register_string_token(const char* s);
-const char* get_string_token_label(unsigned char token);
-bool is_string_token_char(unsigned char token);
+// 一个词法单元 / 匹配结果：起始偏移、长度与规则编号
+typedef struct {
+    int offset;
+    int length;
+    int rule;
+} LexToken;
+
+// NFA 邻接索引：ε 边与字符边按起点分组（CSR），字符边标签为 256 位位图
+typedef struct {
+    int n;
+    int* eps_start; /* epsilon successors of v: eps_dst[eps_start[v] .. eps_start[v + 1]) */
+    int* eps_dst;
+    int* sym_start; /* labelled edges of v: sym_dst / sym_bits[sym_start[v] .. sym_start[v + 1]) */
+    int* sym_dst;
+    unsigned char (*sym_bits)[32];
+} NFAIndex;
+
+// ==================== 规则属性 ====================
+// keywords 非空时，该规则匹配成功后按词素查关键字表，命中则改为关键字自己的类别
+// action 为 SKIP 的规则照常参与最长匹配，但 lexer_scan_tokens 等输出 LexToken 的接口不输出它的单元
+// 起始条件（模式）：modes 的第 m 位表示规则在模式 m 中有效，0 表示所有模式；switch_mode 非零时匹配后进入 next_mode
+// fold_case 非零时规则不区分大小写，构造前先换成折叠后的副本（见 regexp_unicode.h）
+enum LexerRuleAction {
+    LEXER_ACTION_EMIT = 0,
+    LEXER_ACTION_SKIP
+};
+
+struct LexerRuleAttr {
+    const char** keywords;
+    const int* keyword_categories;
+    int num_keywords;
+    enum LexerRuleAction action;
+    unsigned int modes;
+    int switch_mode;
+    int next_mode;
+    int fold_case;
+};
+
+// 模式数的上限（modes 是 32 位的位掩码）
+#define LEXER_MAX_MODES 32
+
+// 跳过规则的快速路径：起始状态读入 bytes 中任一字节都进入 state，此后读这些字节始终停在接受跳过规则的状态、读其他字节即死，
+// 所以这类字节组成的一整段恰好是一个被跳过的单元，可以按块（SSE2 每次 16 字节）扫过去
+#define LEXER_SKIP_RUN_MAX_STATES 8
+
+struct LexSkipRun {
+    int state;                 /* -1 when no skip rule has this shape */
+    int num_bytes;
+    unsigned char bytes[256];
+    unsigned char member[256]; /* member[c] is 1 for the bytes of the run */
+};
+
+enum LexerEngine {
+    LEXER_ENGINE_DFA = 0,
+    LEXER_ENGINE_NFA,
+    LEXER_ENGINE_SHIFT_AND
+};
+
+// 确定化预算的默认值：超过后 generate_lexer 退回 NFA 模拟
+#define LEXER_DEFAULT_MAX_DFA_STATES 65536
+#define LEXER_DEFAULT_MAX_DFA_MEMORY ((size_t)64 << 20)
+// 状态数不超过该值时为 DFA 额外构造稠密转移表（每个状态 1KB），否则逐边查找
+#define LEXER_DENSE_TABLE_MAX_STATES 16384
+
+// DFA 引擎的转移表格式
+enum LexerTableKind {
+    LEXER_TABLE_DENSE = 0, /* state x 256 rows, fastest, 1KB per state */
+    LEXER_TABLE_COMB       /* comb-vector rows with default-state chaining, much smaller */
+};
+
+struct LexerOptions {
+    struct LexerRuleAttr* rule_attrs; /* NULL, or one entry per rule */
+    int max_dfa_states;               /* 0 means LEXER_DEFAULT_MAX_DFA_STATES */
+    size_t max_dfa_memory;            /* bytes of DFA state sets, 0 means LEXER_DEFAULT_MAX_DFA_MEMORY */
+    enum LexerEngine engine;          /* requested engine; SHIFT_AND falls back to DFA above 64 positions */
+    enum LexerTableKind table;        /* transition table backend of the DFA engine */
+    int num_threads;                  /* > 1 runs subset construction (or per-rule compilation) on that many threads */
+    struct RuleDFACache* rule_cache;  /* non-NULL: compile every rule to its own DFA, cached here, and merge them by product construction */
+    struct ProductMemo* product_memo; /* with rule_cache: product states of the previous build, reused and replaced by this one */
+    const int* rule_ids;              /* stable ids of the rules for product_memo, NULL means the rule indices */
+    struct LexerBuildReport* report;  /* when non-NULL, filled with per-phase timings and sizes of the build */
+    int num_modes;                    /* start conditions compiled into the DFA, 0 or 1 means a single mode */
+};
 
 struct Lexer {
     struct finite_automata* dfa;
     int* dfa_accepting_rules;
     int dfa_size;
+    int num_rules;
+    struct KeywordTable** keyword_tables; /* for every rule r, keyword_tables[r] is its keyword table or NULL */
+    enum LexerEngine engine;
+    struct finite_automata* nfa; /* combined NFA, kept only when the DFA exceeded its budget */
+    NFAIndex* nfa_index;
+    int* nfa_accept_rules;       /* for every NFA vertex v, the rule it accepts or -1 */
+    struct ShiftAndLexer* shift_and;
+    struct DFATable* table;      /* dense transitions of dfa, states renumbered in BFS order; NULL for very large DFAs */
+    struct CombTable* comb;      /* compressed transitions, built instead of table when LEXER_TABLE_COMB is requested */
+    struct LexerStats* stats;    /* runtime counters of the DFA engine, only allocated when built with LEXER_STATS */
+    unsigned char* skip_rules;   /* skip_rules[r] is 1 when rule r has LEXER_ACTION_SKIP; NULL if no rule does */
+    int num_modes;
+    int* mode_starts;            /* start state of every mode, numbered like lexer_dfa_step; NULL for a single mode or without a DFA */
+    int* rule_next_mode;         /* mode entered after a token of rule r, -1 keeps the mode; NULL if no rule switches */
+    struct LexSkipRun skip_run;
 };
 int char_in_set(char c, struct char_set* cs);
 struct char_set* create_char_set_from_range(char start, char end);
@@ -40,20 +141,119 @@ void epsilon_closure(struct finite_automata* nfa, int state, int* visited, int*
 int* get_epsilon_closure(struct finite_automata* nfa, int state, int* size);
 struct char_set* get_alphabet(struct finite_automata* nfa);
 StateSet* move(struct finite_automata* nfa, StateSet* set, char c);
+NFAIndex* build_nfa_index(struct finite_automata* nfa);
+void free_nfa_index(NFAIndex* idx);
+int nfa_index_closure(NFAIndex* idx, int* set, int size, int* mark, int stamp);
+int compute_byte_classes(NFAIndex* idx, unsigned char* classes);
 
 
 struct finite_automata* combine_nfas(struct finite_automata** nfas, int num_nfas, int** accepting_states, int* num_accepting);
+struct finite_automata* combine_nfas_modes(struct finite_automata** nfas, int num_nfas, int num_modes, const unsigned int* rule_modes, int** accepting_states, int* num_accepting);
+struct finite_automata* build_combined_nfa(struct frontend_regexp** regexps, int num_regexps, int** accepting_states, int* num_accepting);
 
 // ==================== DFA转换函数 ====================
-struct finite_automata* nfa_to_dfa(struct finite_automata* nfa, int* accepting_states, int num_accepting, int* dfa_accepting_rules);
+struct finite_automata* nfa_to_dfa(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules);
+struct finite_automata* nfa_to_dfa_bounded(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules, int max_states, size_t max_memory);
+struct finite_automata* nfa_to_dfa_profiled(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules, int max_states, size_t max_memory, struct LexerBuildReport* report);
+struct finite_automata* nfa_to_dfa_modes(struct finite_automata* nfa, int* accepting_states, int num_accepting, int num_roots, int** dfa_accepting_rules, int* start_states, int max_states, size_t max_memory, struct LexerBuildReport* report);
+struct finite_automata* nfa_to_dfa_parallel(struct finite_automata* nfa, int* accepting_states, int num_accepting, int** dfa_accepting_rules, int max_states, size_t max_memory, int num_threads, struct LexerBuildReport* report);
+void add_grouped_edges(struct finite_automata* dfa, int src, const int* byte_target);
+int* build_accept_rule_map(struct finite_automata* nfa, int* accepting_states, int num_accepting);
 
 // ==================== 词法分析函数 ====================
 void lexical_analysis(struct finite_automata* dfa, int* dfa_accepting_rules, char* input, int* segments, int* categories);
+void lexical_analysis_with_stats(struct finite_automata* dfa, int* dfa_accepting_rules, char* input, int* segments, int* categories, struct LexerStats* stats);
+void nfa_lexical_analysis(NFAIndex* idx, int* accept_rules, char* input, int* segments, int* categories);
+
+// NFA 模拟在 lexer_munch.h 驱动下的游标：current 是当前状态集合，每个单元从起始状态的闭包 start_set 重新开始；
+// 集合的工作区与 NFA 一样大，由 nfa_cursor_init 分配
+struct NFACursor {
+    NFAIndex* idx;
+    int* accept_rules;
+    int* start_set;
+    int start_size;
+    int start_rule;
+    int* current;
+    int* next;
+    int* mark;
+    int size;
+    int rule;
+    int stamp;
+};
+void nfa_cursor_init(struct NFACursor* cur, NFAIndex* idx, int* accept_rules);
+void nfa_cursor_free(struct NFACursor* cur);
+int nfa_munch(struct NFACursor* cur, struct LexMunch* m, const char* input, int len, int eof);
 
 // ==================== 主流程函数 ====================
 struct Lexer* generate_lexer(struct frontend_regexp** regexps, int num_regexps);
+struct Lexer* generate_lexer_with_options(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options);
+struct Lexer* lexer_from_dfa(struct finite_automata* dfa, int* dfa_accepting_rules, int num_rules, struct LexerOptions* options);
+void lexer_tokenize(struct Lexer* lexer, char* input, int* segments, int* categories);
+int lexer_scan_tokens(struct Lexer* lexer, const char* input, LexToken* tokens); /* tokens holds strlen(input) + 1 entries; return the count */
+int lexer_scan_tokens_in_mode(struct Lexer* lexer, const char* input, LexToken* tokens, int* mode); /* starts in *mode and leaves the final mode there; -1 if modes need a DFA the lexer lacks */
+int lexer_scan_tokens_n(struct Lexer* lexer, const char* input, int len, LexToken* tokens); /* scans exactly len bytes in place, '\0' included; tokens holds len + 1 entries */
+void lexer_reorder_states(struct Lexer* lexer, char** corpus, int num_inputs);
 void run_lexer(struct Lexer* lexer, char* input);
 
+// DFA 引擎的单步转移与接受规则，供逐字节驱动 DFA 的模块使用：优先用稠密表，其次压缩表，最后逐边查找；
+// 同一个词法分析器总是用同一种表示，状态编号前后一致
+static inline int lexer_dfa_step(struct Lexer* lexer, int s, unsigned char c) {
+    if (lexer->table) return lexer->table->next[(size_t)s * 256 + c];
+    if (lexer->comb) return comb_table_next(lexer->comb, s, c);
+    struct finite_automata* dfa = lexer->dfa;
+    for (int e = 0; e < dfa->m; e++) {
+        if (dfa->src[e] == s && dfa->lb[e].n > 0 && char_in_set((char)c, &dfa->lb[e])) return dfa->dst[e];
+    }
+    return -1;
+}
+
+static inline int lexer_dfa_accept(struct Lexer* lexer, int s) {
+    if (lexer->table) return lexer->table->accept[s];
+    if (lexer->comb) return lexer->comb->accept[s];
+    return lexer->dfa_accepting_rules[s];
+}
+
+// 模式 mode 的起始状态；模式 0 的起始状态总是 0
+static inline int lexer_mode_start(struct Lexer* lexer, int mode) {
+    return lexer->mode_starts ? lexer->mode_starts[mode] : 0;
+}
+
+// 规则 rule 的单元之后所处的模式
+static inline int lexer_next_mode(struct Lexer* lexer, int rule, int mode) {
+    if (!lexer->rule_next_mode || rule < 0 || lexer->rule_next_mode[rule] == -1) return mode;
+    return lexer->rule_next_mode[rule];
+}
+
+// DFA 引擎接到 lexer_munch.h 的驱动上：start 是当前模式的起始状态，调用者切换模式时改写它
+struct LexDFACursor {
+    struct Lexer* lexer;
+    int start;
+    int state;
+};
+
+static inline void lexer_dfa_cursor_reset(void* ctx) {
+    struct LexDFACursor* cur = (struct LexDFACursor*)ctx;
+    cur->state = cur->start;
+}
+
+static inline int lexer_dfa_cursor_step(void* ctx, unsigned char c) {
+    struct LexDFACursor* cur = (struct LexDFACursor*)ctx;
+    int next = lexer_dfa_step(cur->lexer, cur->state, c);
+    if (next == -1) return 0;
+    cur->state = next;
+    return 1;
+}
+
+static inline int lexer_dfa_cursor_accept(void* ctx) {
+    struct LexDFACursor* cur = (struct LexDFACursor*)ctx;
+    return lexer_dfa_accept(cur->lexer, cur->state);
+}
+
+static inline int lexer_dfa_munch(struct LexDFACursor* cur, struct LexMunch* m, const char* input, int len, int eof) {
+    static const LexMunchOps ops = { lexer_dfa_cursor_reset, lexer_dfa_cursor_step, lexer_dfa_cursor_accept };
+    return lex_munch(&ops, cur, m, (const unsigned char*)input, len, eof);
+}
+
 // ==================== 内存释放函数 ====================
 void free_lexer(struct Lexer* lexer);
 void free_simpl_regexp(struct simpl_regexp* sr);
@@ -61,6 +261,11 @@ void free_frontend_regexp(struct frontend_regexp* fr);
 void free_finite_automata(struct finite_automata* fa);
 
 // ==================== 新增规则函数声明 ====================
+struct frontend_regexp* create_digit_regex();
+struct frontend_regexp* create_alpha_regex();
+struct frontend_regexp* create_identifier_regex();
+struct frontend_regexp* create_integer_regex();
+struct frontend_regexp* create_whitespace_regex();
 struct frontend_regexp* create_operator_regex();
 struct frontend_regexp* create_comparison_regex();
 struct frontend_regexp* create_punctuation_regex();
@@ -0,0 +1,140 @@
+#ifndef LEXER_HPP_INCLUDED
+#define LEXER_HPP_INCLUDED
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+extern "C" {
+#include "lang.h"
+#include "lexer.h"
+}
+
+// C++17 封装：lex::Lexer 以 RAII 方式持有 struct Lexer，tokens() 返回惰性的词法单元区间。
+// 迭代器每次前进只匹配下一个单元，不生成数组、不分配内存，可以随时停下；
+// 结果与 lexer_scan_tokens 相同（跳过规则的单元不出现，从模式 0 开始切换模式，'\0' 视为输入结束），逐单元拉取只支持 DFA 引擎
+namespace lex {
+
+struct Token {
+    std::string_view text;
+    int rule;            /* rule or keyword category, -1 for an error segment */
+    std::size_t offset;
+};
+
+class TokenIterator {
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Token;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Token*;
+    using reference = const Token&;
+
+    TokenIterator() = default;
+    TokenIterator(::Lexer* lexer, std::string_view input) : lexer_(lexer), input_(input), cursor_{lexer, lexer_mode_start(lexer, 0), 0}, done_(false) {
+        lex_munch_init(&munch_, 0);
+        advance();
+    }
+
+    reference operator*() const { return token_; }
+    pointer operator->() const { return &token_; }
+    TokenIterator& operator++() {
+        advance();
+        return *this;
+    }
+    void operator++(int) { advance(); }
+
+    // 只区分“已结束”与“未结束”，足够 range-for 与逐个拉取使用
+    bool operator==(const TokenIterator& other) const { return done_ == other.done_; }
+    bool operator!=(const TokenIterator& other) const { return done_ != other.done_; }
+
+private:
+    // 跳过规则的单元不交给调用者，继续取下一个
+    void advance() {
+        do {
+            match();
+        } while (!done_ && skipped_);
+    }
+
+    // 由 lexer_munch.h 的驱动切出下一个单元，之后按规则切换模式
+    void match() {
+        if (done_ || lexer_dfa_munch(&cursor_, &munch_, input_.data(), static_cast<int>(input_.size()), 1) != LEX_MUNCH_UNIT) {
+            done_ = true;
+            return;
+        }
+        int rule = munch_.rule;
+        std::size_t start = static_cast<std::size_t>(munch_.offset), length = static_cast<std::size_t>(munch_.length);
+        skipped_ = rule >= 0 && lexer_->skip_rules && lexer_->skip_rules[rule];
+        mode_ = lexer_next_mode(lexer_, rule, mode_);
+        cursor_.start = lexer_mode_start(lexer_, mode_);
+        token_ = {input_.substr(start, length), reclassify(rule, start, start + length), start};
+    }
+
+    // 与 lexer_scan_tokens 一致：关键字按单元自己的词素查找
+    int reclassify(int rule, std::size_t start, std::size_t end) const {
+        if (rule < 0 || rule >= lexer_->num_rules || !lexer_->keyword_tables[rule]) return rule;
+        int keyword = keyword_table_lookup(lexer_->keyword_tables[rule], input_.data() + start, static_cast<int>(end - start));
+        return keyword != -1 ? keyword : rule;
+    }
+
+    ::Lexer* lexer_ = nullptr;
+    std::string_view input_;
+    LexDFACursor cursor_{};
+    LexMunch munch_{};
+    int mode_ = 0;
+    Token token_{};
+    bool skipped_ = false;
+    bool done_ = true;
+};
+
+class TokenRange {
+public:
+    TokenRange(::Lexer* lexer, std::string_view input) : lexer_(lexer), input_(input) {}
+    TokenIterator begin() const { return TokenIterator(lexer_, input_); }
+    TokenIterator end() const { return TokenIterator(); }
+
+private:
+    ::Lexer* lexer_;
+    std::string_view input_;
+};
+
+class Lexer {
+public:
+    // 规则与 options 的含义同 generate_lexer_with_options；规则只在构造期间使用
+    Lexer(struct frontend_regexp** regexps, int num_regexps, LexerOptions* options = nullptr)
+        : lexer_(generate_lexer_with_options(regexps, num_regexps, options)) {}
+    explicit Lexer(::Lexer* lexer) noexcept : lexer_(lexer) {} /* takes ownership */
+    ~Lexer() {
+        if (lexer_) free_lexer(lexer_);
+    }
+
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+    Lexer(Lexer&& other) noexcept : lexer_(std::exchange(other.lexer_, nullptr)) {}
+    Lexer& operator=(Lexer&& other) noexcept {
+        if (this != &other) {
+            if (lexer_) free_lexer(lexer_);
+            lexer_ = std::exchange(other.lexer_, nullptr);
+        }
+        return *this;
+    }
+
+    ::Lexer* get() const noexcept { return lexer_; }
+    ::Lexer* release() noexcept { return std::exchange(lexer_, nullptr); }
+
+    // 区间引用 input 的内容，input 必须在遍历期间保持有效
+    TokenRange tokens(std::string_view input) const {
+        if (!lexer_ || lexer_->engine != LEXER_ENGINE_DFA) throw std::logic_error("Pull-based tokens need the DFA engine.");
+        std::size_t nul = input.find('\0');
+        if (nul != std::string_view::npos) input = input.substr(0, nul);
+        return TokenRange(lexer_, input);
+    }
+
+private:
+    ::Lexer* lexer_;
+};
+
+} // namespace lex
+
+#endif // LEXER_HPP_INCLUDED
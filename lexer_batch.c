@@ -0,0 +1,147 @@
+#define _POSIX_C_SOURCE 200809L
+#include "lexer_batch.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define LEX_POOL_MAX_THREADS 64
+
+typedef struct {
+    struct LexPool* pool;
+    int index;
+    atomic_int next;  /* next unclaimed input of this worker's range, also advanced by thieves */
+    int end;
+    LexToken* tokens; /* used when an output buffer is too small to take every token */
+    int cap;          /* tokens holds cap + 1 entries */
+} LexPoolWorker;
+
+struct LexPool {
+    int num_threads;
+    pthread_t threads[LEX_POOL_MAX_THREADS];
+    LexPoolWorker workers[LEX_POOL_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    int generation;   /* bumped for every batch */
+    int active;       /* helper threads still working on the current batch */
+    int shutdown;
+
+    struct Lexer* lexer;
+    const char* const* inputs;
+    const int* lens;
+    struct LexBatchOutput* outputs;
+};
+
+// 按长度直接扫描调用者的输入，不复制；输出缓冲区放得下 len + 1 个单元时直接写进去，否则先写到暂存区再截断
+static void lex_one(LexPoolWorker* w, int i) {
+    struct LexPool* pool = w->pool;
+    int len = pool->lens[i];
+    struct LexBatchOutput* out = &pool->outputs[i];
+    if (out->capacity > len) {
+        out->count = lexer_scan_tokens_n(pool->lexer, pool->inputs[i], len, out->tokens);
+        return;
+    }
+    if (len > w->cap) {
+        while (len > w->cap) w->cap *= 2;
+        w->tokens = realloc(w->tokens, (w->cap + 1) * sizeof(LexToken));
+    }
+    int count = lexer_scan_tokens_n(pool->lexer, pool->inputs[i], len, w->tokens);
+    if (count > 0) memcpy(out->tokens, w->tokens, (count < out->capacity ? count : out->capacity) * sizeof(LexToken));
+    out->count = count;
+}
+
+// 先做自己的一段，再轮流从其他线程的段里取
+static void run_worker(LexPoolWorker* w) {
+    struct LexPool* pool = w->pool;
+    int i;
+    while ((i = atomic_fetch_add(&w->next, 1)) < w->end) lex_one(w, i);
+    for (int k = 1; k < pool->num_threads; k++) {
+        LexPoolWorker* victim = &pool->workers[(w->index + k) % pool->num_threads];
+        while ((i = atomic_fetch_add(&victim->next, 1)) < victim->end) lex_one(w, i);
+    }
+}
+
+static void* pool_thread_main(void* arg) {
+    LexPoolWorker* w = arg;
+    struct LexPool* pool = w->pool;
+    int seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->generation == seen && !pool->shutdown) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        run_worker(w);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+struct LexPool* create_lex_pool(int num_threads) {
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > LEX_POOL_MAX_THREADS) num_threads = LEX_POOL_MAX_THREADS;
+    struct LexPool* pool = calloc(1, sizeof(struct LexPool));
+    pool->num_threads = num_threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int t = 0; t < num_threads; t++) {
+        LexPoolWorker* w = &pool->workers[t];
+        w->pool = pool;
+        w->index = t;
+        w->cap = 256;
+        w->tokens = malloc((w->cap + 1) * sizeof(LexToken));
+        atomic_init(&w->next, 0);
+    }
+    for (int t = 1; t < num_threads; t++) pthread_create(&pool->threads[t], NULL, pool_thread_main, &pool->workers[t]);
+    return pool;
+}
+
+void free_lex_pool(struct LexPool* pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 1; t < pool->num_threads; t++) pthread_join(pool->threads[t], NULL);
+    for (int t = 0; t < pool->num_threads; t++) {
+        free(pool->workers[t].tokens);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
+
+int lex_batch(struct LexPool* pool, struct Lexer* lexer, const char* const* inputs, const int* lens, int n, struct LexBatchOutput* outputs) {
+    if (lexer->engine != LEXER_ENGINE_DFA) return -1;
+    pool->lexer = lexer;
+    pool->inputs = inputs;
+    pool->lens = lens;
+    pool->outputs = outputs;
+    // 运行时统计的计数器不是线程安全的，带统计构建时整批在调用线程上完成
+    int helpers = lexer->stats ? 0 : pool->num_threads - 1;
+    int parts = helpers + 1;
+    for (int t = 0; t < pool->num_threads; t++) {
+        LexPoolWorker* w = &pool->workers[t];
+        int begin = t < parts ? (int)((long long)n * t / parts) : n;
+        w->end = t < parts ? (int)((long long)n * (t + 1) / parts) : n;
+        atomic_store(&w->next, begin);
+    }
+    if (helpers > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pool->active = helpers;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    run_worker(&pool->workers[0]);
+    if (helpers > 0) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->active > 0) pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return 0;
+}
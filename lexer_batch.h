@@ -0,0 +1,27 @@
+#ifndef LEXER_BATCH_H_INCLUDED
+#define LEXER_BATCH_H_INCLUDED
+
+#include "lexer.h"
+
+// 批量词法分析：一组互相独立的短输入分给常驻的线程池。每个线程先处理自己的一段输入，
+// 做完后逐个窃取其他线程尚未处理的输入。struct Lexer 生成后只读，可以被所有线程共用。
+// 输入按长度直接在原缓冲区上扫描，不复制；每个线程的暂存区随池一起分配，只在遇到更长的输入时扩大，
+// 稳定后一次批量调用不做任何分配。仅支持 DFA 引擎，NFA 模拟每个输入都要分配状态集合。
+// 以 STATS=1 构建时统计计数器不是线程安全的，lex_batch 整批在调用线程上完成。
+// 一个池同一时刻只能执行一次 lex_batch
+struct LexPool;
+
+// 调用者提供的词法单元缓冲区；单元数超过 capacity 时只写前 capacity 个，count 仍是实际个数
+struct LexBatchOutput {
+    LexToken* tokens;
+    int capacity;
+    int count;
+};
+
+struct LexPool* create_lex_pool(int num_threads); /* num_threads includes the calling thread */
+void free_lex_pool(struct LexPool* pool);
+// inputs[i] 的前 lens[i] 个字节切分到 outputs[i]，结果与 lexer_scan_tokens_n 相同（跳过规则的单元不输出）；
+// 返回 0，引擎不是 DFA 时返回 -1，不写任何输出
+int lex_batch(struct LexPool* pool, struct Lexer* lexer, const char* const* inputs, const int* lens, int n, struct LexBatchOutput* outputs);
+
+#endif // LEXER_BATCH_H_INCLUDED
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lang.h"
+#include "lexer.h"
+
+// 词法分析吞吐量基准：生成确定性的合成语料，用各个引擎反复切分并报告 MB/s、ns/byte 与 tokens/s
+// 用法：lexer_bench.exe [语料字节数] [重复次数]
+
+#define BENCH_DEFAULT_BYTES (1 << 20)
+#define BENCH_DEFAULT_REPS 5
+#define BENCH_WARMUP_REPS 1
+// 回退型语料中每段 a 串的长度（含分隔空格）
+#define BENCH_ADVERSARIAL_RUN 256
+
+static unsigned int bench_state;
+
+static void bench_seed(unsigned int seed) {
+    bench_state = seed ? seed : 1;
+}
+
+// xorshift32，保证每次运行生成的语料逐字节相同
+static unsigned int bench_rand(void) {
+    unsigned int x = bench_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bench_state = x;
+    return x;
+}
+
+static void append_str(char* buf, int* pos, int len, const char* s) {
+    while (*s && *pos < len) buf[(*pos)++] = *s++;
+}
+
+static void append_random(char* buf, int* pos, int len, const char* alphabet, int count) {
+    int n = strlen(alphabet);
+    for (int i = 0; i < count && *pos < len; i++) buf[(*pos)++] = alphabet[bench_rand() % n];
+}
+
+// 类似源代码：语句模板中填入随机标识符与整数
+static void gen_source(char* buf, int len) {
+    static const char* keywords[] = {"if", "while", "return", "int", "for", "else"};
+    static const char* ops[] = {" = ", " + ", " - ", " * ", " < ", " >= ", " == ", " / "};
+    int pos = 0;
+    bench_seed(1);
+    while (pos < len) {
+        switch (bench_rand() % 4) {
+        case 0:
+            append_str(buf, &pos, len, keywords[bench_rand() % 6]);
+            append_str(buf, &pos, len, " (");
+            append_random(buf, &pos, len, "abcdefghijklmnopqrstuvwxyz", 1 + bench_rand() % 8);
+            append_str(buf, &pos, len, ops[bench_rand() % 8]);
+            append_random(buf, &pos, len, "0123456789", 1 + bench_rand() % 5);
+            append_str(buf, &pos, len, ") {\n");
+            break;
+        case 1:
+            append_str(buf, &pos, len, "    ");
+            append_random(buf, &pos, len, "abcdefghijklmnopqrstuvwxyz", 1 + bench_rand() % 10);
+            append_str(buf, &pos, len, ops[bench_rand() % 8]);
+            append_random(buf, &pos, len, "abcdefghijklmnopqrstuvwxyz0123456789", 1 + bench_rand() % 10);
+            append_str(buf, &pos, len, ";\n");
+            break;
+        case 2:
+            append_str(buf, &pos, len, "    call(");
+            append_random(buf, &pos, len, "0123456789", 1 + bench_rand() % 6);
+            append_str(buf, &pos, len, ", array[");
+            append_random(buf, &pos, len, "abcdefghijklmnopqrstuvwxyz", 1 + bench_rand() % 4);
+            append_str(buf, &pos, len, "], 'A');\n");
+            break;
+        default:
+            append_str(buf, &pos, len, "}\n");
+            break;
+        }
+    }
+    buf[len] = '\0';
+}
+
+// 以空白为主：长串空格 / 制表符 / 换行夹杂短单词
+static void gen_whitespace(char* buf, int len) {
+    int pos = 0;
+    bench_seed(2);
+    while (pos < len) {
+        append_random(buf, &pos, len, "    \t\n", 8 + bench_rand() % 120);
+        append_random(buf, &pos, len, "abcdefghijklmnopqrstuvwxyz", 1 + bench_rand() % 4);
+    }
+    buf[len] = '\0';
+}
+
+// 很长的标识符，单个空格分隔
+static void gen_long_identifiers(char* buf, int len) {
+    int pos = 0;
+    bench_seed(3);
+    while (pos < len) {
+        append_random(buf, &pos, len, "abcdefghijklmnopqrstuvwxyz", 1);
+        append_random(buf, &pos, len, "abcdefghijklmnopqrstuvwxyz0123456789", 63 + bench_rand() % 960);
+        append_str(buf, &pos, len, " ");
+    }
+    buf[len] = '\0';
+}
+
+// 随机二进制（不含 0 字节，输入以 '\0' 结尾），大部分字节落入错误段
+static void gen_binary(char* buf, int len) {
+    bench_seed(4);
+    for (int i = 0; i < len; i++) buf[i] = (char)(1 + bench_rand() % 255);
+    buf[len] = '\0';
+}
+
+// 回退型：规则 a、a+b 与空白下由空格分隔的长 a 串；每个 a 都要读到串尾再退回，耗时与串长成平方关系
+static void gen_adversarial(char* buf, int len) {
+    for (int i = 0; i < len; i++) buf[i] = (i % BENCH_ADVERSARIAL_RUN == BENCH_ADVERSARIAL_RUN - 1) ? ' ' : 'a';
+    buf[len] = '\0';
+}
+
+static struct frontend_regexp** create_backtracking_rules(int* num_rules) {
+    *num_rules = 3;
+    struct frontend_regexp** regexps = malloc(3 * sizeof(struct frontend_regexp*));
+    regexps[0] = create_whitespace_regex();
+    regexps[1] = TFr_SingleChar('a');
+    regexps[2] = TFr_Concat(TFr_Plus(TFr_SingleChar('a')), TFr_SingleChar('b'));
+    return regexps;
+}
+
+struct BenchCorpus {
+    const char* name;
+    void (*generate)(char* buf, int len);
+    int adversarial;  /* lexed with create_backtracking_rules instead of create_default_rules */
+};
+
+static const struct BenchCorpus corpora[] = {
+    {"source", gen_source, 0},
+    {"whitespace", gen_whitespace, 0},
+    {"long-identifiers", gen_long_identifiers, 0},
+    {"binary", gen_binary, 0},
+    {"adversarial", gen_adversarial, 1},
+};
+
+static const struct {
+    const char* name;
+    enum LexerEngine engine;
+    int edge_scan;  /* run lexical_analysis on the edge list instead of lexer_tokenize */
+    enum LexerTableKind table;
+} engines[] = {
+    {"dfa", LEXER_ENGINE_DFA, 1, LEXER_TABLE_DENSE},
+    {"dfa-table", LEXER_ENGINE_DFA, 0, LEXER_TABLE_DENSE},
+    {"dfa-comb", LEXER_ENGINE_DFA, 0, LEXER_TABLE_COMB},
+    {"nfa", LEXER_ENGINE_NFA, 0, LEXER_TABLE_DENSE},
+    {"shift-and", LEXER_ENGINE_SHIFT_AND, 0, LEXER_TABLE_DENSE},
+};
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_engine(struct Lexer* lexer, int edge_scan, char* input, int* segments, int* categories) {
+    if (edge_scan) {
+        lexical_analysis(lexer->dfa, lexer->dfa_accepting_rules, input, segments, categories);
+    } else {
+        lexer_tokenize(lexer, input, segments, categories);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bytes = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_BYTES;
+    int reps = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_REPS;
+    if (bytes <= 0) bytes = BENCH_DEFAULT_BYTES;
+    if (reps <= 0) reps = BENCH_DEFAULT_REPS;
+
+    int num_default, num_backtracking;
+    struct frontend_regexp** default_rules = create_default_rules(&num_default);
+    struct frontend_regexp** backtracking_rules = create_backtracking_rules(&num_backtracking);
+    int num_engines = sizeof(engines) / sizeof(engines[0]);
+    struct Lexer* lexers[2][5];
+    for (int e = 0; e < num_engines; e++) {
+        struct LexerOptions options = {0};
+        options.engine = engines[e].engine;
+        options.table = engines[e].table;
+        lexers[0][e] = generate_lexer_with_options(default_rules, num_default, &options);
+        lexers[1][e] = generate_lexer_with_options(backtracking_rules, num_backtracking, &options);
+    }
+
+    char* input = malloc(bytes + 1);
+    int* segments = malloc((bytes + 2) * sizeof(int));
+    int* categories = malloc((bytes + 2) * sizeof(int));
+    double* times = malloc(reps * sizeof(double));
+
+    printf("%d warmup + %d timed runs per row, median reported\n", BENCH_WARMUP_REPS, reps);
+    printf("%-18s %-10s %10s %10s %10s %10s %12s\n", "corpus", "engine", "bytes", "tokens", "MB/s", "ns/byte", "Mtokens/s");
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++) {
+        int len = bytes;
+        corpora[c].generate(input, len);
+        for (int e = 0; e < num_engines; e++) {
+            struct Lexer* lexer = lexers[corpora[c].adversarial][e];
+            // 位置数超过 64 时 SHIFT_AND 会退回 DFA，此时该行与 dfa 行重复，跳过
+            if (lexer->engine != engines[e].engine) continue;
+            for (int r = 0; r < BENCH_WARMUP_REPS; r++) run_engine(lexer, engines[e].edge_scan, input, segments, categories);
+            for (int r = 0; r < reps; r++) {
+                double start = lexer_profile_now_ms();
+                run_engine(lexer, engines[e].edge_scan, input, segments, categories);
+                times[r] = lexer_profile_now_ms() - start;
+            }
+            int tokens = 0;
+            while (segments[tokens] != -1) tokens++;
+            qsort(times, reps, sizeof(double), compare_doubles);
+            double seconds = times[reps / 2] / 1000.0;
+            if (seconds <= 0) seconds = 1e-9;
+            printf("%-18s %-10s %10d %10d %10.2f %10.2f %12.3f\n", corpora[c].name, engines[e].name, len, tokens,
+                   len / seconds / (1 << 20), seconds * 1e9 / len, tokens / seconds / 1e6);
+        }
+    }
+
+    for (int e = 0; e < num_engines; e++) {
+        free_lexer(lexers[0][e]);
+        free_lexer(lexers[1][e]);
+    }
+    free(default_rules);
+    free(backtracking_rules);
+    free(input);
+    free(segments);
+    free(categories);
+    free(times);
+    return 0;
+}
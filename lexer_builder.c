@@ -0,0 +1,79 @@
+#include "lexer_builder.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct LexerBuilder* create_lexer_builder(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options) {
+    struct LexerBuilder* builder = calloc(1, sizeof(struct LexerBuilder));
+    if (options) builder->options = *options;
+    builder->cache = create_rule_dfa_cache();
+    builder->memo = create_product_memo();
+    builder->cap = num_regexps > 8 ? num_regexps : 8;
+    builder->regexps = malloc(builder->cap * sizeof(struct frontend_regexp*));
+    builder->rule_attrs = calloc(builder->cap, sizeof(struct LexerRuleAttr));
+    builder->rule_ids = malloc(builder->cap * sizeof(int));
+    for (int i = 0; i < num_regexps; i++) {
+        builder->regexps[i] = regexps[i];
+        if (options && options->rule_attrs) builder->rule_attrs[i] = options->rule_attrs[i];
+        builder->rule_ids[i] = builder->next_id++;
+    }
+    builder->num_rules = num_regexps;
+    return builder;
+}
+
+void free_lexer_builder(struct LexerBuilder* builder) {
+    if (!builder) return;
+    free_rule_dfa_cache(builder->cache);
+    free_product_memo(builder->memo);
+    free(builder->regexps);
+    free(builder->rule_attrs);
+    free(builder->rule_ids);
+    free(builder);
+}
+
+void lexer_builder_add_rule(struct LexerBuilder* builder, int index, struct frontend_regexp* fr, struct LexerRuleAttr* attr) {
+    if (index < 0 || index > builder->num_rules) index = builder->num_rules;
+    if (builder->num_rules == builder->cap) {
+        builder->cap *= 2;
+        builder->regexps = realloc(builder->regexps, builder->cap * sizeof(struct frontend_regexp*));
+        builder->rule_attrs = realloc(builder->rule_attrs, builder->cap * sizeof(struct LexerRuleAttr));
+        builder->rule_ids = realloc(builder->rule_ids, builder->cap * sizeof(int));
+    }
+    int tail = builder->num_rules - index;
+    memmove(builder->regexps + index + 1, builder->regexps + index, tail * sizeof(struct frontend_regexp*));
+    memmove(builder->rule_attrs + index + 1, builder->rule_attrs + index, tail * sizeof(struct LexerRuleAttr));
+    memmove(builder->rule_ids + index + 1, builder->rule_ids + index, tail * sizeof(int));
+    builder->regexps[index] = fr;
+    if (attr) {
+        builder->rule_attrs[index] = *attr;
+    } else {
+        memset(&builder->rule_attrs[index], 0, sizeof(struct LexerRuleAttr));
+    }
+    builder->rule_ids[index] = builder->next_id++;
+    builder->num_rules++;
+}
+
+void lexer_builder_remove_rule(struct LexerBuilder* builder, int index) {
+    if (index < 0 || index >= builder->num_rules) return;
+    int tail = builder->num_rules - index - 1;
+    memmove(builder->regexps + index, builder->regexps + index + 1, tail * sizeof(struct frontend_regexp*));
+    memmove(builder->rule_attrs + index, builder->rule_attrs + index + 1, tail * sizeof(struct LexerRuleAttr));
+    memmove(builder->rule_ids + index, builder->rule_ids + index + 1, tail * sizeof(int));
+    builder->num_rules--;
+}
+
+// 规则属性（关键字表）保持不变，只换正则
+void lexer_builder_replace_rule(struct LexerBuilder* builder, int index, struct frontend_regexp* fr) {
+    if (index < 0 || index >= builder->num_rules) return;
+    builder->regexps[index] = fr;
+    builder->rule_ids[index] = builder->next_id++;
+}
+
+// 引擎不是 DFA 时 generate_lexer_with_options 不走逐规则编译，缓存与备忘都不会被用到，结果与整体构造相同
+struct Lexer* lexer_builder_build(struct LexerBuilder* builder) {
+    struct LexerOptions options = builder->options;
+    options.rule_attrs = builder->rule_attrs;
+    options.rule_cache = builder->cache;
+    options.product_memo = builder->memo;
+    options.rule_ids = builder->rule_ids;
+    return generate_lexer_with_options(builder->regexps, builder->num_rules, &options);
+}
@@ -0,0 +1,29 @@
+#ifndef LEXER_BUILDER_H_INCLUDED
+#define LEXER_BUILDER_H_INCLUDED
+
+#include "lexer.h"
+
+// 增量构造：规则可以逐条增删改，lexer_builder_build 每次只重新编译改动过的规则，
+// 其余规则的 DFA 来自构造器自己的规则缓存；乘积状态中只涉及未改动规则的部分沿用上一次构造的转移行。
+// 每次添加或替换都给规则分配新的稳定编号，旧编号的元组在之后的构造中不会再被匹配到。
+// 规则正则的所有权仍在调用者手里，必须在构造器使用期间保持有效
+struct LexerBuilder {
+    struct frontend_regexp** regexps;
+    struct LexerRuleAttr* rule_attrs; /* one entry per rule, zeroed when the rule has no attributes */
+    int* rule_ids;                    /* stable id of every rule */
+    int num_rules;
+    int cap;
+    int next_id;
+    struct LexerOptions options;      /* copy of the caller's options; the fields below replace rule_cache / product_memo / rule_ids */
+    struct RuleDFACache* cache;
+    struct ProductMemo* memo;
+};
+
+struct LexerBuilder* create_lexer_builder(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options);
+void free_lexer_builder(struct LexerBuilder* builder);
+void lexer_builder_add_rule(struct LexerBuilder* builder, int index, struct frontend_regexp* fr, struct LexerRuleAttr* attr); /* attr may be NULL */
+void lexer_builder_remove_rule(struct LexerBuilder* builder, int index);
+void lexer_builder_replace_rule(struct LexerBuilder* builder, int index, struct frontend_regexp* fr);
+struct Lexer* lexer_builder_build(struct LexerBuilder* builder);
+
+#endif // LEXER_BUILDER_H_INCLUDED
@@ -0,0 +1,283 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "lexer_cache.h"
+#include "regexp_unicode.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char cache_magic[4] = {'L', 'X', 'C', '1'};
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} ByteBuffer;
+
+static void buf_put(ByteBuffer* b, const void* bytes, size_t n) {
+    if (b->len + n > b->cap) {
+        while (b->len + n > b->cap) b->cap = b->cap ? b->cap * 2 : 256;
+        b->data = realloc(b->data, b->cap);
+    }
+    memcpy(b->data + b->len, bytes, n);
+    b->len += n;
+}
+
+static void buf_put_u32(ByteBuffer* b, uint32_t v) {
+    buf_put(b, &v, sizeof(v));
+}
+
+static void buf_put_u64(ByteBuffer* b, uint64_t v) {
+    buf_put(b, &v, sizeof(v));
+}
+
+static uint64_t hash64(const char* s, size_t len) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 读文件时的游标，越界后 ok 置 0，之后的读取都返回 0
+typedef struct {
+    const char* data;
+    size_t len;
+    size_t pos;
+    int ok;
+} Reader;
+
+static void read_bytes(Reader* r, void* out, size_t n) {
+    if (!r->ok || r->len - r->pos < n) {
+        r->ok = 0;
+        memset(out, 0, n);
+        return;
+    }
+    memcpy(out, r->data + r->pos, n);
+    r->pos += n;
+}
+
+static uint32_t read_u32(Reader* r) {
+    uint32_t v;
+    read_bytes(r, &v, sizeof(v));
+    return v;
+}
+
+static uint64_t read_u64(Reader* r) {
+    uint64_t v;
+    read_bytes(r, &v, sizeof(v));
+    return v;
+}
+
+// 键：格式版本、字节序标记、规则数、各规则的规范形式、状态数与内存预算；
+// 表格式、线程数与关键字表不影响 DFA，不进入键
+static void build_cache_key(ByteBuffer* key, struct frontend_regexp** regexps, int num_regexps, int max_states, size_t max_memory) {
+    buf_put_u32(key, LEXER_CACHE_VERSION);
+    buf_put_u32(key, 0x01020304u);
+    buf_put_u32(key, (uint32_t)num_regexps);
+    for (int i = 0; i < num_regexps; i++) {
+        size_t len;
+        char* canonical = canonical_regexp(regexps[i], &len);
+        buf_put_u64(key, len);
+        buf_put(key, canonical, len);
+        free(canonical);
+    }
+    buf_put_u32(key, (uint32_t)max_states);
+    buf_put_u64(key, max_memory);
+}
+
+static char* cache_path(const char* dir, uint64_t hash, const char* suffix) {
+    size_t len = strlen(dir) + strlen(suffix) + 64;
+    char* path = malloc(len);
+    snprintf(path, len, "%s/%016llx%s", dir, (unsigned long long)hash, suffix);
+    return path;
+}
+
+static char* read_whole_file(const char* path, size_t* len) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    char* data = NULL;
+    long size;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc(size);
+        if (fread(data, 1, size, f) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+        *len = size;
+    }
+    fclose(f);
+    return data;
+}
+
+// 返回 1 表示命中：*dfa 非空是缓存的 DFA，为空表示该规则集超出了预算
+static int load_cache_entry(const char* path, const ByteBuffer* key, struct finite_automata** dfa, int** dfa_accepting_rules) {
+    size_t len = 0;
+    char* data = read_whole_file(path, &len);
+    if (!data) return 0;
+    if (len < sizeof(uint32_t)) {
+        free(data);
+        return 0;
+    }
+    *dfa = NULL;
+    *dfa_accepting_rules = NULL;
+    // 校验和在文件末尾，覆盖它之前的全部内容
+    Reader r = {data, len - sizeof(uint32_t), 0, 1};
+    uint32_t checksum;
+    memcpy(&checksum, data + r.len, sizeof(checksum));
+    char magic[4];
+    read_bytes(&r, magic, sizeof(magic));
+    uint64_t key_len = read_u64(&r);
+    int hit = r.ok && (uint32_t)hash64(data, r.len) == checksum && memcmp(magic, cache_magic, sizeof(magic)) == 0 &&
+              key_len == key->len && r.len - r.pos >= key_len && memcmp(data + r.pos, key->data, key->len) == 0;
+    if (!hit) {
+        free(data);
+        return 0;
+    }
+    r.pos += key_len;
+    int n = (int)read_u32(&r);
+    if (n >= 0) {
+        int m = (int)read_u32(&r);
+        int* rules = malloc((n + 1) * sizeof(int));
+        read_bytes(&r, rules, n * sizeof(int));
+        struct finite_automata* g = create_empty_graph();
+        g->n = n;
+        char chars[256];
+        for (int e = 0; e < m && r.ok; e++) {
+            int src = (int)read_u32(&r), dst = (int)read_u32(&r);
+            uint32_t count = read_u32(&r);
+            if (count > sizeof(chars) || src < 0 || src >= n || dst < 0 || dst >= n) r.ok = 0;
+            read_bytes(&r, chars, r.ok ? count : 0);
+            struct char_set cs = {chars, count};
+            if (r.ok) add_one_edge(g, src, dst, &cs);
+        }
+        if (!r.ok || r.pos != r.len) {
+            free_finite_automata(g);
+            free(rules);
+            hit = 0;
+        } else {
+            *dfa = g;
+            *dfa_accepting_rules = rules;
+        }
+    }
+    free(data);
+    return hit;
+}
+
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+// 先写临时文件并刷到磁盘，再原子地换成正式文件名；任何一步失败都只是放弃写入
+static void store_cache_entry(const char* dir, uint64_t hash, const ByteBuffer* key, struct finite_automata* dfa, int* dfa_accepting_rules) {
+    static atomic_uint counter;
+    ByteBuffer out = {0};
+    buf_put(&out, cache_magic, sizeof(cache_magic));
+    buf_put_u64(&out, key->len);
+    buf_put(&out, key->data, key->len);
+    if (dfa) {
+        buf_put_u32(&out, (uint32_t)dfa->n);
+        buf_put_u32(&out, (uint32_t)dfa->m);
+        buf_put(&out, dfa_accepting_rules, dfa->n * sizeof(int));
+        for (int e = 0; e < dfa->m; e++) {
+            buf_put_u32(&out, (uint32_t)dfa->src[e]);
+            buf_put_u32(&out, (uint32_t)dfa->dst[e]);
+            buf_put_u32(&out, dfa->lb[e].n);
+            buf_put(&out, dfa->lb[e].c, dfa->lb[e].n);
+        }
+    } else {
+        buf_put_u32(&out, (uint32_t)-1);
+    }
+    buf_put_u32(&out, (uint32_t)hash64(out.data, out.len));
+
+#ifdef _WIN32
+    _mkdir(dir);
+    unsigned long pid = (unsigned long)_getpid();
+#else
+    mkdir(dir, 0777);
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", pid, atomic_fetch_add(&counter, 1));
+    char* tmp = cache_path(dir, hash, suffix);
+    char* path = cache_path(dir, hash, ".lexc");
+    FILE* f = fopen(tmp, "wb");
+    int ok = f != NULL;
+    if (f) {
+        ok = fwrite(out.data, 1, out.len, f) == out.len && fflush(f) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(f)) == 0;
+#else
+        ok = ok && fsync(fileno(f)) == 0;
+#endif
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok || replace_file(tmp, path) != 0) remove(tmp);
+    free(tmp);
+    free(path);
+    free(out.data);
+}
+
+struct Lexer* generate_lexer_cached(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options, const char* cache_dir) {
+    enum LexerEngine requested = options ? options->engine : LEXER_ENGINE_DFA;
+    // 多模式的 DFA 还要记下各模式的起始状态，不进缓存
+    bool modes = options && options->num_modes > 1;
+    if (!cache_dir || requested != LEXER_ENGINE_DFA || modes) return generate_lexer_with_options(regexps, num_regexps, options);
+
+    struct LexerBuildReport* report = options ? options->report : NULL;
+    double t_begin = lexer_profile_now_ms();
+    int max_states = (options && options->max_dfa_states) ? options->max_dfa_states : LEXER_DEFAULT_MAX_DFA_STATES;
+    size_t max_memory = (options && options->max_dfa_memory) ? options->max_dfa_memory : LEXER_DEFAULT_MAX_DFA_MEMORY;
+    ByteBuffer key = {0};
+    // 键按折叠后的规则计算，与实际构造时用的规则一致
+    struct frontend_regexp** folded = fold_rule_cases(regexps, num_regexps, options);
+    build_cache_key(&key, folded ? folded : regexps, num_regexps, max_states, max_memory);
+    free_folded_rules(folded, regexps, num_regexps);
+    uint64_t hash = hash64(key.data, key.len);
+    char* path = cache_path(cache_dir, hash, ".lexc");
+
+    struct finite_automata* dfa;
+    int* dfa_accepting_rules;
+    struct Lexer* lexer = NULL;
+    if (load_cache_entry(path, &key, &dfa, &dfa_accepting_rules)) {
+        if (dfa) {
+            lexer = lexer_from_dfa(dfa, dfa_accepting_rules, num_regexps, options);
+            if (report) {
+                memset(report, 0, sizeof(*report));
+                report->num_rules = num_regexps;
+                report->dfa_states = dfa->n;
+                report->dfa_edges = dfa->m;
+                report->table_memory = lexer->comb ? comb_table_memory(lexer->comb) : lexer->table ? dfa_table_memory(lexer->table) : 0;
+                report->total_ms = lexer_profile_now_ms() - t_begin;
+                report->peak_rss = lexer_profile_peak_rss();
+            }
+        } else {
+            // 已知超出预算，跳过确定化
+            struct LexerOptions nfa_options = {0};
+            if (options) nfa_options = *options;
+            nfa_options.engine = LEXER_ENGINE_NFA;
+            lexer = generate_lexer_with_options(regexps, num_regexps, &nfa_options);
+            if (report) report->dfa_over_budget = 1;
+        }
+        if (report) report->cache_hit = 1;
+    } else {
+        lexer = generate_lexer_with_options(regexps, num_regexps, options);
+        store_cache_entry(cache_dir, hash, &key, lexer->dfa, lexer->dfa_accepting_rules);
+    }
+    free(path);
+    free(key.data);
+    return lexer;
+}
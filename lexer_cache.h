@@ -0,0 +1,16 @@
+#ifndef LEXER_CACHE_H_INCLUDED
+#define LEXER_CACHE_H_INCLUDED
+
+#include "lexer.h"
+
+// 按内容寻址的编译缓存：规则的规范形式与影响确定化的选项（预算）拼成键，键的哈希作文件名。
+// 命中时直接从 cache_dir 读回 DFA，稠密表 / 压缩表与关键字表按 options 重新构造；未命中时正常生成并写入。
+// 超出预算的规则集也记一条，下次直接走 NFA 模拟，不再重复尝试确定化。
+// 写入先落到带进程号的临时文件再 rename，并发的多个进程互不干扰，读者只会看到完整的文件；
+// 文件中保存完整的键并带校验和，哈希碰撞或损坏的文件都当作未命中。文件按本机字节序写出，不跨平台共享
+#define LEXER_CACHE_VERSION 1
+
+// 只缓存 DFA 引擎；其他引擎或 cache_dir 为 NULL 时等同 generate_lexer_with_options
+struct Lexer* generate_lexer_cached(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options, const char* cache_dir);
+
+#endif // LEXER_CACHE_H_INCLUDED
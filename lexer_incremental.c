@@ -0,0 +1,128 @@
+#include "lexer_incremental.h"
+#include <string.h>
+
+static void reserve_tokens(LexToken** tokens, int** scan_end, int* cap, int need) {
+    if (need <= *cap) return;
+    while (*cap < need) *cap = *cap ? *cap * 2 : 64;
+    *tokens = realloc(*tokens, *cap * sizeof(LexToken));
+    *scan_end = realloc(*scan_end, *cap * sizeof(int));
+}
+
+// 与 lexer_tokenize 一致：关键字按单元自己的词素查找
+static void reclassify_keyword(struct IncrementalLexer* inc, LexToken* tok) {
+    struct Lexer* lexer = inc->lexer;
+    if (tok->rule < 0 || tok->rule >= lexer->num_rules || !lexer->keyword_tables[tok->rule]) return;
+    int keyword = keyword_table_lookup(lexer->keyword_tables[tok->rule], inc->text + tok->offset, tok->length);
+    if (keyword != -1) tok->rule = keyword;
+}
+
+// 从 pos 起匹配一个单元；返回 1 表示此后不再有单元
+static int match_token(struct IncrementalLexer* inc, int pos, LexToken* tok, int* scan_end, int* emitted) {
+    struct LexDFACursor cur = { inc->lexer, 0, 0 };
+    struct LexMunch m;
+    lex_munch_init(&m, pos);
+    *emitted = lexer_dfa_munch(&cur, &m, inc->text, inc->len, 1) == LEX_MUNCH_UNIT;
+    if (!*emitted) {
+        *scan_end = inc->len;
+        return 1;
+    }
+    tok->offset = m.offset;
+    tok->length = m.length;
+    tok->rule = m.rule;
+    *scan_end = m.scan_end;
+    reclassify_keyword(inc, tok);
+    return m.done;
+}
+
+// 第一个 offset >= target 的单元下标
+static int lower_bound_offset(const LexToken* tokens, int lo, int hi, int target) {
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (tokens[mid].offset < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void replace_text(struct IncrementalLexer* inc, int start, int old_len, const char* new_text, int new_len) {
+    int new_total = inc->len - old_len + new_len;
+    if (new_total + 1 > inc->text_cap) {
+        while (new_total + 1 > inc->text_cap) inc->text_cap = inc->text_cap ? inc->text_cap * 2 : 256;
+        inc->text = realloc(inc->text, inc->text_cap);
+    }
+    memmove(inc->text + start + new_len, inc->text + start + old_len, inc->len - start - old_len + 1);
+    memcpy(inc->text + start, new_text, new_len);
+    inc->len = new_total;
+}
+
+struct IncrementalLexer* create_incremental_lexer(struct Lexer* lexer, const char* text, int len) {
+    if (lexer->engine != LEXER_ENGINE_DFA) return NULL;
+    struct IncrementalLexer* inc = calloc(1, sizeof(struct IncrementalLexer));
+    inc->lexer = lexer;
+    inc->text_cap = 256;
+    inc->text = malloc(inc->text_cap);
+    inc->text[0] = '\0';
+    struct TokenEdit changed;
+    incremental_lexer_edit(inc, 0, 0, text, len, &changed);
+    return inc;
+}
+
+void free_incremental_lexer(struct IncrementalLexer* inc) {
+    if (!inc) return;
+    free(inc->text);
+    free(inc->tokens);
+    free(inc->scan_end);
+    free(inc->scratch);
+    free(inc->scratch_end);
+    free(inc);
+}
+
+int incremental_lexer_edit(struct IncrementalLexer* inc, int start, int old_len, const char* new_text, int new_len, struct TokenEdit* changed) {
+    if (start < 0 || old_len < 0 || new_len < 0 || start > inc->len || old_len > inc->len - start) return -1;
+    int delta = new_len - old_len;
+    replace_text(inc, start, old_len, new_text, new_len);
+
+    // 第一个受影响的单元：scan_end >= start；起点比 start 早 max_lookahead 以上的单元不可能读到编辑区
+    int f = lower_bound_offset(inc->tokens, 0, inc->count, start - inc->max_lookahead);
+    while (f < inc->count && inc->scan_end[f] < start) f++;
+    int pos = f > 0 ? inc->tokens[f - 1].offset + inc->tokens[f - 1].length : 0;
+
+    // 重新分析，直到新单元的起点越过编辑区并与旧单元的起点重合
+    int edit_end = start + new_len;
+    int n = 0, resync = inc->count, at_end = 0, restart = pos, furthest = pos;
+    while (!at_end && pos <= inc->len) {
+        if (pos >= edit_end) {
+            int k = lower_bound_offset(inc->tokens, f, inc->count, pos - delta);
+            if (k < inc->count && inc->tokens[k].offset == pos - delta) {
+                resync = k;
+                break;
+            }
+        }
+        reserve_tokens(&inc->scratch, &inc->scratch_end, &inc->scratch_cap, n + 1);
+        int emitted;
+        at_end = match_token(inc, pos, &inc->scratch[n], &inc->scratch_end[n], &emitted);
+        if (inc->scratch_end[n] > furthest) furthest = inc->scratch_end[n];
+        if (!emitted) break;
+        if (inc->scratch_end[n] - pos > inc->max_lookahead) inc->max_lookahead = inc->scratch_end[n] - pos;
+        pos += inc->scratch[n].length;
+        n++;
+    }
+    inc->last_relexed = furthest - restart;
+
+    // 拼接：保留 [0, f)，插入新单元，其后的旧单元平移 delta
+    int tail = inc->count - resync;
+    reserve_tokens(&inc->tokens, &inc->scan_end, &inc->cap, f + n + tail + 1);
+    memmove(inc->tokens + f + n, inc->tokens + resync, tail * sizeof(LexToken));
+    memmove(inc->scan_end + f + n, inc->scan_end + resync, tail * sizeof(int));
+    for (int i = f + n; delta != 0 && i < f + n + tail; i++) {
+        inc->tokens[i].offset += delta;
+        inc->scan_end[i] += delta;
+    }
+    memcpy(inc->tokens + f, inc->scratch, n * sizeof(LexToken));
+    memcpy(inc->scan_end + f, inc->scratch_end, n * sizeof(int));
+    changed->first = f;
+    changed->removed = resync - f;
+    changed->inserted = n;
+    inc->count = f + n + tail;
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef LEXER_INCREMENTAL_H_INCLUDED
+#define LEXER_INCREMENTAL_H_INCLUDED
+
+#include "lexer.h"
+
+// 增量词法分析：为编辑器 / LSP 保存文档的词法单元，每次编辑只重新分析受影响的一段。
+// 每个词法单元的起点都是 DFA 回到起始状态的同步点，另外记录匹配它时读到的最远位置 scan_end：
+// 编辑从 scan_end 不早于编辑起点的第一个单元开始重新分析，一旦新的单元起点越过编辑区、
+// 并且与编辑前某个单元的起点（平移后）重合，之后的结果必然与原来相同，立即停止。
+// 重新分析的字节数只与编辑附近的单元有关；之后的单元只需平移偏移量。
+// 与 lexer_tokenize 一样始终按模式 0 切分，多个模式的词法分析器也不切换模式
+struct IncrementalLexer {
+    struct Lexer* lexer;   /* borrowed, must outlive the incremental lexer */
+    char* text;            /* the document, kept '\0'-terminated */
+    int len;
+    int text_cap;
+    LexToken* tokens;      /* same tokens and categories as lexer_tokenize on text */
+    int* scan_end;         /* for every token, the furthest position read while matching it; len if the scan hit the end */
+    int count;
+    int cap;
+    int max_lookahead;     /* largest scan_end - offset seen so far, bounds how far back an edit can reach */
+    LexToken* scratch;     /* tokens of the re-lexed span before they are spliced in */
+    int* scratch_end;
+    int scratch_cap;
+    int last_relexed;      /* bytes scanned by the last edit */
+};
+
+// 一次编辑后变化的词法单元：新的 tokens[first, first + inserted) 替换了原来的 [first, first + removed)
+struct TokenEdit {
+    int first;
+    int removed;
+    int inserted;
+};
+
+// 仅支持 DFA 引擎，其他引擎返回 NULL
+struct IncrementalLexer* create_incremental_lexer(struct Lexer* lexer, const char* text, int len);
+void free_incremental_lexer(struct IncrementalLexer* inc);
+// 把 text[start, start + old_len) 替换为 new_text 的 new_len 个字节；范围非法时返回 -1，文档不变
+int incremental_lexer_edit(struct IncrementalLexer* inc, int start, int old_len, const char* new_text, int new_len, struct TokenEdit* changed);
+
+#endif // LEXER_INCREMENTAL_H_INCLUDED
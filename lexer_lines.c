@@ -0,0 +1,146 @@
+#include "lexer_lines.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+int count_newlines(const char* input, int len, int* last) {
+    int count = 0, i = 0;
+    *last = -1;
+#if defined(__SSE2__)
+    // 每块 16 字节：比较得到换行的位掩码，个数用 popcount，最后一个换行取掩码的最高位
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(input + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask) {
+            count += __builtin_popcount(mask);
+            *last = i + 31 - __builtin_clz(mask);
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if (input[i] == '\n') {
+            count++;
+            *last = i;
+        }
+    }
+    return count;
+}
+
+static void push_line_start(struct LineIndex* index, int* cap, int offset) {
+    if (index->num_lines == *cap) {
+        *cap *= 2;
+        index->starts = realloc(index->starts, *cap * sizeof(int));
+    }
+    index->starts[index->num_lines++] = offset;
+}
+
+// 一次扫描：每块的换行位掩码逐位取出，换行的下一个字节就是行首
+struct LineIndex* build_line_index(const char* input, int len) {
+    struct LineIndex* index = malloc(sizeof(struct LineIndex));
+    int cap = 64;
+    index->starts = malloc(cap * sizeof(int));
+    index->num_lines = 0;
+    index->len = len;
+    push_line_start(index, &cap, 0);
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(input + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        while (mask) {
+            push_line_start(index, &cap, i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if (input[i] == '\n') push_line_start(index, &cap, i + 1);
+    }
+    return index;
+}
+
+void free_line_index(struct LineIndex* index) {
+    if (!index) return;
+    free(index->starts);
+    free(index);
+}
+
+// 最后一个不超过 offset 的行首
+struct LexPosition line_index_lookup(const struct LineIndex* index, int offset) {
+    int lo = 0, hi = index->num_lines - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (index->starts[mid] <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    struct LexPosition pos = {lo + 1, offset - index->starts[lo] + 1};
+    return pos;
+}
+
+// 64 字节一块的换行位掩码，第 k 位对应 input[base + k]；输入末尾不满一块的部分逐字节补齐
+static unsigned long long newline_mask(const char* input, int len, int base) {
+    unsigned long long mask = 0;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i < 64 && base + i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(input + base + i));
+        mask |= (unsigned long long)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)) << i;
+    }
+#endif
+    for (; i < 64 && base + i < len; i++) {
+        if (input[base + i] == '\n') mask |= 1ULL << i;
+    }
+    return mask;
+}
+
+// 逐块前进的游标：line 为块首所在的行号，last_newline 为块首之前最后一个换行
+typedef struct {
+    const char* input;
+    int len;
+    int base;
+    unsigned long long mask;
+    int line;
+    int last_newline;
+} LineCursor;
+
+static void cursor_reset(LineCursor* c) {
+    c->base = 0;
+    c->mask = newline_mask(c->input, c->len, 0);
+    c->line = 1;
+    c->last_newline = -1;
+}
+
+// 跨过的整块只做一次 popcount，块内的位置用掩码的低位部分定出行号与最近的换行
+static struct LexPosition cursor_position(LineCursor* c, int offset) {
+    if (offset < c->base) cursor_reset(c);
+    while (offset >= c->base + 64) {
+        if (c->mask) {
+            c->line += __builtin_popcountll(c->mask);
+            c->last_newline = c->base + 63 - __builtin_clzll(c->mask);
+        }
+        c->base += 64;
+        c->mask = newline_mask(c->input, c->len, c->base);
+    }
+    unsigned long long before = c->mask & ((1ULL << (offset - c->base)) - 1);
+    struct LexPosition pos;
+    pos.line = c->line + __builtin_popcountll(before);
+    pos.column = offset - (before ? c->base + 63 - __builtin_clzll(before) : c->last_newline);
+    return pos;
+}
+
+void lexer_token_positions(const char* input, const LexToken* tokens, int num_tokens, struct LexPosition* starts, struct LexPosition* ends) {
+    if (num_tokens <= 0) return;
+    LineCursor c;
+    c.input = input;
+    c.len = strlen(input);
+    cursor_reset(&c);
+    for (int i = 0; i < num_tokens; i++) {
+        starts[i] = cursor_position(&c, tokens[i].offset);
+        if (ends) ends[i] = cursor_position(&c, tokens[i].offset + tokens[i].length);
+    }
+}
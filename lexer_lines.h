@@ -0,0 +1,32 @@
+#ifndef LEXER_LINES_H_INCLUDED
+#define LEXER_LINES_H_INCLUDED
+
+#include "lexer.h"
+
+// 行列号：词法单元只带字节偏移，需要报告位置时再算行列号，不必让每个使用者各自从头扫描输入。
+// 两种用法：按需查询时先用一次 SIMD 扫描建好行首索引，之后每次二分查找；
+// 一次要很多单元的位置时按偏移顺序走一遍，每 64 字节的换行位掩码用 SIMD 只算一次，单元的行列号由掩码的 popcount 得出。
+// 行号与列号都从 1 开始，列按字节计，只有 '\n' 换行（"\r\n" 的 '\r' 算作上一行的最后一列）
+struct LexPosition {
+    int line;
+    int column;
+};
+
+struct LineIndex {
+    int* starts;    /* starts[k] is the offset where line k + 1 begins; starts[0] is 0 */
+    int num_lines;
+    int len;        /* bytes of the indexed input */
+};
+
+// input[0, len) 中 '\n' 的个数；*last 为最后一个 '\n' 的下标，没有时为 -1
+int count_newlines(const char* input, int len, int* last);
+
+struct LineIndex* build_line_index(const char* input, int len);
+void free_line_index(struct LineIndex* index);
+struct LexPosition line_index_lookup(const struct LineIndex* index, int offset); /* 0 <= offset <= len */
+
+// 按偏移从小到大排列的单元的起点位置写入 starts，ends 非 NULL 时再写入单元末尾（最后一个字节之后）的位置；
+// 单元不按顺序时从头重新计数，结果仍然正确
+void lexer_token_positions(const char* input, const LexToken* tokens, int num_tokens, struct LexPosition* starts, struct LexPosition* ends);
+
+#endif // LEXER_LINES_H_INCLUDED
@@ -0,0 +1,112 @@
+#ifndef LEXER_MUNCH_H_INCLUDED
+#define LEXER_MUNCH_H_INCLUDED
+
+// 最长匹配驱动：各个引擎（边表 DFA、稠密表、压缩表、NFA 模拟、Shift-And）与各个输出单元的接口
+// （lexer_scan_tokens、增量分析、流水线、lexer.hpp）共用这一个切分循环。引擎只提供三个回调，
+// 状态保存在引擎自己的 ctx 里：DFA 是状态编号，NFA 模拟是状态集合，Shift-And 是位向量。
+// 切分规则：读到死转移时切出最长匹配，没有规则接受时从起点到出错字节是一个错误单元（类别 -1）；
+// 输入末尾与死转移相同，最长匹配没到末尾就从接受位置继续切分，剩下没有规则接受的字节整体是一个错误单元，
+// 所以单元首尾相接、覆盖整个输入。末尾的空匹配结束切分。
+// 驱动是 static inline，引擎把回调也写成 static inline 并放进 static const 的 LexMunchOps，回调会被内联进循环
+typedef struct {
+    void (*reset)(void* ctx);                 /* back to the start state before the next unit */
+    int (*step)(void* ctx, unsigned char c);  /* 0 when the engine dies on c */
+    int (*accept)(void* ctx);                 /* rule accepted in the current state, or -1 */
+} LexMunchOps;
+
+#define LEX_MUNCH_MORE 0  /* the input ran out before its end, call again once more bytes follow */
+#define LEX_MUNCH_UNIT 1  /* a unit was cut, see offset / length / rule */
+#define LEX_MUNCH_END 2   /* the end of the input was reached, no unit */
+
+// 切分进度，可以跨多次调用保留（流水线分块到达的输入）
+struct LexMunch {
+    int pos;          /* next byte to read */
+    int start;        /* start of the unit being matched */
+    int accept_rule;  /* longest match of that unit so far, -1 for none */
+    int accept_pos;
+    int active;       /* the engine holds a partial match of [start, pos) */
+    int done;
+    int offset;       /* the unit cut by the last LEX_MUNCH_UNIT */
+    int length;
+    int rule;
+    int scan_end;     /* furthest position read while matching it */
+};
+
+static inline void lex_munch_init(struct LexMunch* m, int pos) {
+    m->pos = m->start = pos;
+    m->accept_rule = m->accept_pos = -1;
+    m->active = m->done = 0;
+}
+
+// 尚未切出的第一个字节
+static inline int lex_munch_pending(const struct LexMunch* m) {
+    return m->active ? m->start : m->pos;
+}
+
+// 输入缓冲区丢掉开头的 shift 个字节后，位置随之前移
+static inline void lex_munch_rebase(struct LexMunch* m, int shift) {
+    m->pos -= shift;
+    m->start -= shift;
+    if (m->accept_pos >= 0) m->accept_pos -= shift;
+}
+
+static inline int lex_munch_cut(struct LexMunch* m, int length, int rule, int next, int scan_end) {
+    m->offset = m->start;
+    m->length = length;
+    m->rule = rule;
+    m->scan_end = scan_end;
+    m->pos = next;
+    m->active = 0;
+    return LEX_MUNCH_UNIT;
+}
+
+// 从 m->pos 起读 input[0, len)，切出下一个单元；eof 为 0 时 len 之后还有输入，读到 len 只返回 LEX_MUNCH_MORE
+static inline int lex_munch(const LexMunchOps* ops, void* ctx, struct LexMunch* m, const unsigned char* input, int len, int eof) {
+    if (m->done) return LEX_MUNCH_END;
+    if (!m->active) {
+        ops->reset(ctx);
+        m->start = m->pos;
+        m->accept_rule = ops->accept(ctx);
+        m->accept_pos = m->accept_rule != -1 ? m->pos : -1;
+        m->active = 1;
+    }
+    int pos = m->pos;
+    while (pos < len) {
+        if (!ops->step(ctx, input[pos])) {
+            if (m->accept_rule != -1) return lex_munch_cut(m, m->accept_pos - m->start, m->accept_rule, m->accept_pos, pos);
+            return lex_munch_cut(m, pos + 1 - m->start, -1, pos + 1, pos);
+        }
+        pos++;
+        int rule = ops->accept(ctx);
+        if (rule != -1) {
+            m->accept_rule = rule;
+            m->accept_pos = pos;
+        }
+    }
+    m->pos = pos;
+    if (!eof) return LEX_MUNCH_MORE;
+    m->done = 1;
+    if (m->accept_rule != -1) {
+        if (m->accept_pos != m->start && m->accept_pos != len) m->done = 0;
+        return lex_munch_cut(m, m->accept_pos - m->start, m->accept_rule, m->accept_pos, len);
+    }
+    if (m->start < len) return lex_munch_cut(m, len - m->start, -1, len, len);
+    m->active = 0;
+    return LEX_MUNCH_END;
+}
+
+// 整段输入切分成 lexical_analysis 的输出格式：segments 为各段起点，categories 为类别，均以 -1 结尾
+static inline void lex_munch_segments(const LexMunchOps* ops, void* ctx, const char* input, int len, int* segments, int* categories) {
+    struct LexMunch m;
+    int count = 0;
+    lex_munch_init(&m, 0);
+    while (lex_munch(ops, ctx, &m, (const unsigned char*)input, len, 1) == LEX_MUNCH_UNIT) {
+        segments[count] = m.offset;
+        categories[count] = m.rule;
+        count++;
+    }
+    segments[count] = -1;
+    categories[count] = -1;
+}
+
+#endif // LEXER_MUNCH_H_INCLUDED
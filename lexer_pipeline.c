@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200809L
+#include "lexer_pipeline.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// 单生产者 / 单消费者环：生产者只写 head，消费者只写 tail，槽位 i % size 由两者按序交接
+typedef struct {
+    atomic_size_t head;
+    atomic_size_t tail;
+    size_t size;
+} SpscRing;
+
+// 生产者拿到可写的槽位编号；环满时让出 CPU 等消费者
+static size_t ring_reserve(SpscRing* r) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    while (head - atomic_load_explicit(&r->tail, memory_order_acquire) == r->size) sched_yield();
+    return head % r->size;
+}
+
+static void ring_publish(SpscRing* r) {
+    atomic_fetch_add_explicit(&r->head, 1, memory_order_release);
+}
+
+static size_t ring_peek(SpscRing* r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    while (atomic_load_explicit(&r->head, memory_order_acquire) == tail) sched_yield();
+    return tail % r->size;
+}
+
+static void ring_release(SpscRing* r) {
+    atomic_fetch_add_explicit(&r->tail, 1, memory_order_release);
+}
+
+typedef struct {
+    char* data;
+    int len;
+    int last;       /* end of input (or read error) after this chunk */
+} PipeChunk;
+
+typedef struct {
+    LexToken* tokens;
+    int count;
+    char* text;
+    int text_len;
+    int text_cap;
+    long long stream_offset;
+    int last;       /* no batches follow */
+} PipeBatch;
+
+typedef struct {
+    struct Lexer* lexer;
+    FILE* in;
+    int chunk_size;
+    int batch_tokens;
+    SpscRing chunk_ring;
+    PipeChunk* chunks;
+    SpscRing batch_ring;
+    PipeBatch* batches;
+    atomic_int stop;     /* the lexer saw '\0', the reader may quit early */
+    int read_error;
+
+    // 词法线程的窗口：win 里从 lex_munch_pending 到 win_len 是尚未切出的字节，win[0] 位于输入的 win_offset 处
+    char* win;
+    int win_len;
+    int win_cap;
+    long long win_offset;
+    PipeBatch* batch;    /* batch being filled, or NULL */
+} Pipeline;
+
+static void* reader_main(void* arg) {
+    Pipeline* p = arg;
+    while (1) {
+        PipeChunk* c = &p->chunks[ring_reserve(&p->chunk_ring)];
+        c->len = atomic_load(&p->stop) ? 0 : (int)fread(c->data, 1, p->chunk_size, p->in);
+        c->last = c->len < p->chunk_size;
+        if (c->last && ferror(p->in)) p->read_error = 1;
+        ring_publish(&p->chunk_ring);
+        if (c->last) break;
+    }
+    return NULL;
+}
+
+static void flush_batch(Pipeline* p, int last) {
+    if (!p->batch) {
+        if (!last) return;
+        p->batch = &p->batches[ring_reserve(&p->batch_ring)];
+        p->batch->count = 0;
+        p->batch->text_len = 0;
+    }
+    p->batch->last = last;
+    ring_publish(&p->batch_ring);
+    p->batch = NULL;
+}
+
+// 把 win[start, start + len) 作为一个单元放进当前批；批满时先交出去
+static void emit_token(Pipeline* p, int start, int len, int rule) {
+    struct Lexer* lexer = p->lexer;
+    if (rule >= 0 && lexer->skip_rules && lexer->skip_rules[rule]) {
+        // 跳过的单元不进批，但字节仍拷进已开始的批，保持 text 与输入连续；放不下就结束这一批
+        if (!p->batch) return;
+        if (p->batch->text_len + len > p->batch->text_cap) {
+            flush_batch(p, 0);
+            return;
+        }
+        memcpy(p->batch->text + p->batch->text_len, p->win + start, len);
+        p->batch->text_len += len;
+        return;
+    }
+    if (rule >= 0 && rule < lexer->num_rules && lexer->keyword_tables[rule]) {
+        int keyword = keyword_table_lookup(lexer->keyword_tables[rule], p->win + start, len);
+        if (keyword != -1) rule = keyword;
+    }
+    if (p->batch && (p->batch->count == p->batch_tokens || p->batch->text_len + len > p->batch->text_cap)) flush_batch(p, 0);
+    if (!p->batch) {
+        p->batch = &p->batches[ring_reserve(&p->batch_ring)];
+        p->batch->count = 0;
+        p->batch->text_len = 0;
+        p->batch->stream_offset = p->win_offset + start;
+    }
+    PipeBatch* b = p->batch;
+    if (len > b->text_cap) {
+        // 单个单元比整批的文本区还长，只能扩大这个槽位
+        b->text_cap = len;
+        b->text = realloc(b->text, b->text_cap);
+    }
+    b->tokens[b->count].offset = b->text_len;
+    b->tokens[b->count].length = len;
+    b->tokens[b->count].rule = rule;
+    b->count++;
+    memcpy(b->text + b->text_len, p->win + start, len);
+    b->text_len += len;
+}
+
+// 与 lexer_scan_tokens 相同的最长匹配与模式切换，只是输入分块到达：驱动读到窗口末尾而输入未结束时保留状态，等下一块
+static void* lexer_main(void* arg) {
+    Pipeline* p = arg;
+    struct Lexer* lexer = p->lexer;
+    struct LexDFACursor cur = { lexer, lexer_mode_start(lexer, 0), 0 };
+    struct LexMunch m;
+    int mode = 0, eof = 0, reader_done = 0;
+    lex_munch_init(&m, 0);
+    while (!eof) {
+        PipeChunk* c = &p->chunks[ring_peek(&p->chunk_ring)];
+        int len = c->len;
+        const char* nul = memchr(c->data, '\0', len);
+        if (nul) {
+            len = (int)(nul - c->data);
+            atomic_store(&p->stop, 1);
+        }
+        reader_done = c->last;
+        eof = reader_done || nul;
+
+        // 已经切出的字节不少于未切出的字节时才整理窗口，搬动的字节数不超过丢掉的，跨很多块的长单元不会被反复拷贝；
+        // 然后把新块接到窗口末尾
+        int tok_start = lex_munch_pending(&m);
+        if (tok_start > 0 && tok_start >= p->win_len - tok_start) {
+            memmove(p->win, p->win + tok_start, p->win_len - tok_start);
+            p->win_len -= tok_start;
+            p->win_offset += tok_start;
+            lex_munch_rebase(&m, tok_start);
+        }
+        if (p->win_len + len > p->win_cap) {
+            while (p->win_len + len > p->win_cap) p->win_cap *= 2;
+            p->win = realloc(p->win, p->win_cap);
+        }
+        memcpy(p->win + p->win_len, c->data, len);
+        p->win_len += len;
+        ring_release(&p->chunk_ring);
+
+        while (lexer_dfa_munch(&cur, &m, p->win, p->win_len, eof) == LEX_MUNCH_UNIT) {
+            emit_token(p, m.offset, m.length, m.rule);
+            if (lexer->rule_next_mode) {
+                mode = lexer_next_mode(lexer, m.rule, mode);
+                cur.start = lexer_mode_start(lexer, mode);
+            }
+        }
+        flush_batch(p, eof);
+    }
+    // '\0' 之后的块照常取出，让读线程能够结束
+    while (!reader_done) {
+        PipeChunk* c = &p->chunks[ring_peek(&p->chunk_ring)];
+        reader_done = c->last;
+        ring_release(&p->chunk_ring);
+    }
+    return NULL;
+}
+
+int lex_pipeline(struct Lexer* lexer, FILE* in, const struct LexPipelineConfig* config, LexPipelineCallback callback, void* user) {
+    if (lexer->engine != LEXER_ENGINE_DFA) return -1;
+    Pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.lexer = lexer;
+    p.in = in;
+    p.chunk_size = (config && config->chunk_size > 0) ? config->chunk_size : LEX_PIPELINE_DEFAULT_CHUNK;
+    p.batch_tokens = (config && config->batch_tokens > 0) ? config->batch_tokens : LEX_PIPELINE_DEFAULT_BATCH;
+    int ring_size = (config && config->ring_size > 0) ? config->ring_size : LEX_PIPELINE_DEFAULT_RING;
+    p.chunk_ring.size = p.batch_ring.size = ring_size;
+    atomic_init(&p.chunk_ring.head, 0);
+    atomic_init(&p.chunk_ring.tail, 0);
+    atomic_init(&p.batch_ring.head, 0);
+    atomic_init(&p.batch_ring.tail, 0);
+    atomic_init(&p.stop, 0);
+    p.chunks = calloc(ring_size, sizeof(PipeChunk));
+    p.batches = calloc(ring_size, sizeof(PipeBatch));
+    for (int i = 0; i < ring_size; i++) {
+        p.chunks[i].data = malloc(p.chunk_size);
+        p.batches[i].tokens = malloc(p.batch_tokens * sizeof(LexToken));
+        p.batches[i].text_cap = p.chunk_size;
+        p.batches[i].text = malloc(p.batches[i].text_cap);
+    }
+    p.win_cap = 2 * p.chunk_size;
+    p.win = malloc(p.win_cap);
+
+    pthread_t reader, lexer_thread;
+    pthread_create(&reader, NULL, reader_main, &p);
+    pthread_create(&lexer_thread, NULL, lexer_main, &p);
+    while (1) {
+        PipeBatch* b = &p.batches[ring_peek(&p.batch_ring)];
+        if (b->count > 0) {
+            struct LexTokenBatch batch = {b->tokens, b->count, b->text, b->stream_offset};
+            callback(&batch, user);
+        }
+        int last = b->last;
+        ring_release(&p.batch_ring);
+        if (last) break;
+    }
+    pthread_join(reader, NULL);
+    pthread_join(lexer_thread, NULL);
+
+    for (int i = 0; i < ring_size; i++) {
+        free(p.chunks[i].data);
+        free(p.batches[i].tokens);
+        free(p.batches[i].text);
+    }
+    free(p.chunks);
+    free(p.batches);
+    free(p.win);
+    return p.read_error ? -1 : 0;
+}
@@ -0,0 +1,36 @@
+#ifndef LEXER_PIPELINE_H_INCLUDED
+#define LEXER_PIPELINE_H_INCLUDED
+
+#include <stdio.h>
+#include "lexer.h"
+
+// 流水线词法分析：读线程把文件读进固定大小的缓冲区，词法线程逐块运行 DFA，
+// 跨块的未完成单元（以及回退需要的向前看字节）留在窗口里与下一块拼接；
+// 切好的单元按批经无锁单生产者 / 单消费者环形队列交给调用线程上的回调。
+// 读、切分与下游处理三者重叠进行，内存由环的大小决定（另加最长单元的窗口）。
+// 结果与把整个文件读入内存后调用 lexer_scan_tokens 相同（跳过规则的单元不交给回调），'\0' 视为输入结束；仅支持 DFA 引擎
+#define LEX_PIPELINE_DEFAULT_CHUNK (64 * 1024)
+#define LEX_PIPELINE_DEFAULT_RING 4
+#define LEX_PIPELINE_DEFAULT_BATCH 4096
+
+struct LexPipelineConfig {
+    int chunk_size;   /* bytes per I/O buffer, 0 means LEX_PIPELINE_DEFAULT_CHUNK */
+    int ring_size;    /* slots in each ring, 0 means LEX_PIPELINE_DEFAULT_RING */
+    int batch_tokens; /* tokens per batch, 0 means LEX_PIPELINE_DEFAULT_BATCH */
+};
+
+// 一批连续的单元：tokens[i].offset 是相对 text 的偏移，text[0] 位于输入的 stream_offset 处，text 中也含批内被跳过的字节；
+// 回调返回后 text 与 tokens 即被复用
+struct LexTokenBatch {
+    const LexToken* tokens;
+    int count;
+    const char* text;
+    long long stream_offset;
+};
+
+typedef void (*LexPipelineCallback)(const struct LexTokenBatch* batch, void* user);
+
+// 返回 0；读取出错或引擎不是 DFA 时返回 -1（读取出错前切出的单元已经交给回调）
+int lex_pipeline(struct Lexer* lexer, FILE* in, const struct LexPipelineConfig* config, LexPipelineCallback callback, void* user);
+
+#endif // LEXER_PIPELINE_H_INCLUDED
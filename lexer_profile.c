@@ -0,0 +1,54 @@
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <sys/resource.h>
+#endif
+#include "lexer_profile.h"
+#include <time.h>
+
+double lexer_profile_now_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// 进程的峰值常驻内存（字节）；平台不支持时返回 0
+size_t lexer_profile_peak_rss(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void print_lexer_build_report(struct LexerBuildReport* report, FILE* out) {
+    fprintf(out, "rules:              %d\n", report->num_rules);
+    fprintf(out, "simplify:           %10.3f ms\n", report->simplify_ms);
+    fprintf(out, "shift-and build:    %10.3f ms\n", report->shift_and_ms);
+    fprintf(out, "nfa build:          %10.3f ms\n", report->nfa_build_ms);
+    fprintf(out, "nfa combine:        %10.3f ms\n", report->combine_ms);
+    fprintf(out, "nfa -> dfa:         %10.3f ms%s\n", report->dfa_ms, report->dfa_over_budget ? "  (over budget)" : "");
+    fprintf(out, "nfa fallback index: %10.3f ms\n", report->nfa_fallback_ms);
+    fprintf(out, "keyword tables:     %10.3f ms\n", report->keyword_ms);
+    fprintf(out, "total:              %10.3f ms%s\n", report->total_ms, report->cache_hit ? "  (from cache)" : "");
+    fprintf(out, "nfa vertices:       %d\n", report->nfa_vertices);
+    fprintf(out, "nfa edges:          %d (%d epsilon)\n", report->nfa_edges, report->nfa_epsilon_edges);
+    fprintf(out, "closure calls:      %llu (%llu vertices)\n", report->closure_calls, report->closure_vertices);
+    fprintf(out, "byte classes:       %d (%d on edges)\n", report->byte_classes, report->alphabet_size);
+    fprintf(out, "dfa states:         %d\n", report->dfa_states);
+    fprintf(out, "dfa edges:          %d\n", report->dfa_edges);
+    fprintf(out, "dfa set memory:     %llu bytes\n", (unsigned long long)report->dfa_set_memory);
+    fprintf(out, "table memory:       %llu bytes\n", (unsigned long long)report->table_memory);
+    fprintf(out, "peak rss:           %llu bytes\n", (unsigned long long)report->peak_rss);
+}
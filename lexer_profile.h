@@ -0,0 +1,42 @@
+#ifndef LEXER_PROFILE_H_INCLUDED
+#define LEXER_PROFILE_H_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+
+// 生成词法分析器的分阶段耗时与规模统计：在 LexerOptions.report 非空时由 generate_lexer_with_options 填写，
+// 用于定位规则改动后到底是哪一阶段（简化、NFA、合并、确定化……）变慢
+struct LexerBuildReport {
+    int num_rules;
+
+    /* wall-clock time of every phase, in milliseconds; phases that did not run stay 0 */
+    double simplify_ms;
+    double shift_and_ms;
+    double nfa_build_ms;
+    double combine_ms;
+    double dfa_ms;           /* subset construction, including the NFA index and byte classes */
+    double nfa_fallback_ms;  /* NFA index for the simulation engine when the DFA was abandoned */
+    double keyword_ms;
+    double total_ms;
+
+    int nfa_vertices;        /* combined NFA */
+    int nfa_edges;
+    int nfa_epsilon_edges;
+    unsigned long long closure_calls;     /* epsilon closures computed during subset construction */
+    unsigned long long closure_vertices;  /* NFA vertices produced by those closures */
+    int byte_classes;        /* byte equivalence classes of the combined NFA */
+    int alphabet_size;       /* classes that label at least one edge */
+    int dfa_states;          /* states discovered, also when the budget was exceeded */
+    int dfa_edges;
+    size_t dfa_set_memory;   /* bytes of NFA state sets, the quantity bounded by max_dfa_memory */
+    int dfa_over_budget;
+    size_t table_memory;     /* bytes of the transition table the DFA engine runs on (dense or comb) */
+    size_t peak_rss;         /* peak resident set of the process after the build, 0 if unavailable */
+    int cache_hit;           /* generate_lexer_cached loaded the DFA (or its over-budget verdict) from disk */
+};
+
+double lexer_profile_now_ms(void);
+size_t lexer_profile_peak_rss(void);
+void print_lexer_build_report(struct LexerBuildReport* report, FILE* out);
+
+#endif // LEXER_PROFILE_H_INCLUDED
@@ -0,0 +1,87 @@
+#include "lexer_stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct LexerStats* create_lexer_stats(int num_rules, int num_states) {
+    struct LexerStats* stats = calloc(1, sizeof(struct LexerStats));
+    stats->num_rules = num_rules;
+    stats->num_states = num_states;
+    stats->tokens_per_rule = calloc(num_rules + 1, sizeof(unsigned long long));
+    stats->bytes_per_rule = calloc(num_rules + 1, sizeof(unsigned long long));
+    stats->state_visits = calloc(num_states + 1, sizeof(unsigned long long));
+    return stats;
+}
+
+void reset_lexer_stats(struct LexerStats* stats) {
+    if (!stats) return;
+    stats->calls = 0;
+    stats->bytes_processed = 0;
+    stats->transitions = 0;
+    stats->error_bytes = 0;
+    stats->backtracks = 0;
+    stats->backtrack_bytes = 0;
+    stats->max_backtrack = 0;
+    memset(stats->tokens_per_rule, 0, (stats->num_rules + 1) * sizeof(unsigned long long));
+    memset(stats->bytes_per_rule, 0, (stats->num_rules + 1) * sizeof(unsigned long long));
+    memset(stats->state_visits, 0, (stats->num_states + 1) * sizeof(unsigned long long));
+}
+
+void free_lexer_stats(struct LexerStats* stats) {
+    if (!stats) return;
+    free(stats->tokens_per_rule);
+    free(stats->bytes_per_rule);
+    free(stats->state_visits);
+    free(stats);
+}
+
+void lexer_stats_count_token(struct LexerStats* stats, int rule, int length) {
+    if (rule < 0) {
+        stats->error_bytes += length;
+        return;
+    }
+    if (rule < stats->num_rules) {
+        stats->tokens_per_rule[rule]++;
+        stats->bytes_per_rule[rule] += length;
+    }
+}
+
+void dump_lexer_stats_json(struct LexerStats* stats, FILE* out) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"calls\": %llu,\n", stats->calls);
+    fprintf(out, "  \"bytes_processed\": %llu,\n", stats->bytes_processed);
+    fprintf(out, "  \"transitions\": %llu,\n", stats->transitions);
+    fprintf(out, "  \"error_bytes\": %llu,\n", stats->error_bytes);
+    fprintf(out, "  \"backtracks\": %llu,\n", stats->backtracks);
+    fprintf(out, "  \"backtrack_bytes\": %llu,\n", stats->backtrack_bytes);
+    fprintf(out, "  \"max_backtrack\": %llu,\n", stats->max_backtrack);
+    fprintf(out, "  \"rules\": [");
+    for (int r = 0; r < stats->num_rules; r++) {
+        fprintf(out, "%s\n    {\"rule\": %d, \"tokens\": %llu, \"bytes\": %llu}", r ? "," : "", r,
+                stats->tokens_per_rule[r], stats->bytes_per_rule[r]);
+    }
+    fprintf(out, "\n  ],\n");
+    fprintf(out, "  \"state_visits\": [");
+    for (int s = 0; s < stats->num_states; s++) {
+        fprintf(out, "%s%llu", s ? ", " : "", stats->state_visits[s]);
+    }
+    fprintf(out, "]\n}\n");
+}
+
+// 每行一个指标：metric,key,value；按规则 / 按状态的指标 key 为编号
+void dump_lexer_stats_csv(struct LexerStats* stats, FILE* out) {
+    fprintf(out, "metric,key,value\n");
+    fprintf(out, "calls,,%llu\n", stats->calls);
+    fprintf(out, "bytes_processed,,%llu\n", stats->bytes_processed);
+    fprintf(out, "transitions,,%llu\n", stats->transitions);
+    fprintf(out, "error_bytes,,%llu\n", stats->error_bytes);
+    fprintf(out, "backtracks,,%llu\n", stats->backtracks);
+    fprintf(out, "backtrack_bytes,,%llu\n", stats->backtrack_bytes);
+    fprintf(out, "max_backtrack,,%llu\n", stats->max_backtrack);
+    for (int r = 0; r < stats->num_rules; r++) {
+        fprintf(out, "rule_tokens,%d,%llu\n", r, stats->tokens_per_rule[r]);
+        fprintf(out, "rule_bytes,%d,%llu\n", r, stats->bytes_per_rule[r]);
+    }
+    for (int s = 0; s < stats->num_states; s++) {
+        fprintf(out, "state_visits,%d,%llu\n", s, stats->state_visits[s]);
+    }
+}
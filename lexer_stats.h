@@ -0,0 +1,36 @@
+#ifndef LEXER_STATS_H_INCLUDED
+#define LEXER_STATS_H_INCLUDED
+
+#include <stdio.h>
+
+// 运行时统计：只有用 -DLEXER_STATS 编译（make STATS=1）时 lexical_analysis 才会更新，
+// 默认编译下这些钩子完全不存在，热循环没有额外开销
+struct LexerStats {
+    unsigned long long calls;
+    unsigned long long bytes_processed;  /* input bytes handed to the lexer */
+    unsigned long long transitions;      /* DFA steps, re-scanned bytes included */
+    unsigned long long error_bytes;      /* bytes that ended up in error segments */
+    unsigned long long backtracks;       /* times a token ended before the furthest byte read */
+    unsigned long long backtrack_bytes;  /* total distance of those rewinds */
+    unsigned long long max_backtrack;
+    int num_rules;
+    unsigned long long* tokens_per_rule;
+    unsigned long long* bytes_per_rule;
+    int num_states;
+    unsigned long long* state_visits;    /* for every DFA state s, how many bytes were read in s */
+};
+
+#ifdef LEXER_STATS
+#define LEXER_STAT(stats, stmt) do { if (stats) { stmt; } } while (0)
+#else
+#define LEXER_STAT(stats, stmt) ((void)0)
+#endif
+
+struct LexerStats* create_lexer_stats(int num_rules, int num_states);
+void reset_lexer_stats(struct LexerStats* stats);
+void free_lexer_stats(struct LexerStats* stats);
+void lexer_stats_count_token(struct LexerStats* stats, int rule, int length);
+void dump_lexer_stats_json(struct LexerStats* stats, FILE* out);
+void dump_lexer_stats_csv(struct LexerStats* stats, FILE* out);
+
+#endif // LEXER_STATS_H_INCLUDED
@@ -0,0 +1,184 @@
+#include "lexer_stream.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char lex_stream_magic[4] = {'L', 'X', 'T', '1'};
+
+static void put_u32(unsigned char* p, unsigned int v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char* p, unsigned long long v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static unsigned int get_u32(const unsigned char* p) {
+    return p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static unsigned long long get_u64(const unsigned char* p) {
+    return get_u32(p) | (unsigned long long)get_u32(p + 4) << 32;
+}
+
+static unsigned char* put_varint(unsigned char* p, unsigned int v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+// 单字节的值（最常见的情形）不进循环；超过 5 个字节或越过 end 视为损坏
+static inline int get_varint(const unsigned char** p, const unsigned char* end, unsigned int* v) {
+    const unsigned char* q = *p;
+    if (q < end && *q < 0x80) {
+        *v = *q;
+        *p = q + 1;
+        return 1;
+    }
+    unsigned int x = 0;
+    for (int shift = 0; shift < 35 && q < end; shift += 7) {
+        unsigned char b = *q++;
+        x |= (unsigned int)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            *p = q;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+struct LexStreamWriter* create_lex_stream_writer(int block_size) {
+    struct LexStreamWriter* w = calloc(1, sizeof(struct LexStreamWriter));
+    w->block_size = block_size > 0 ? block_size : 0;
+    w->payload_cap = 4096;
+    w->payload = malloc(w->payload_cap);
+    return w;
+}
+
+void lex_stream_writer_add(struct LexStreamWriter* w, const LexToken* tokens, int num_tokens) {
+    // 每个单元最多 3 个 5 字节的变长整数
+    size_t need = w->payload_len + (size_t)num_tokens * 15;
+    if (need > w->payload_cap) {
+        while (need > w->payload_cap) w->payload_cap *= 2;
+        w->payload = realloc(w->payload, w->payload_cap);
+    }
+    unsigned char* p = w->payload + w->payload_len;
+    for (int i = 0; i < num_tokens; i++) {
+        if (w->block_size && w->num_tokens % w->block_size == 0) {
+            if (w->num_blocks == w->blocks_cap) {
+                w->blocks_cap = w->blocks_cap ? w->blocks_cap * 2 : 16;
+                w->block_offsets = realloc(w->block_offsets, w->blocks_cap * sizeof(unsigned long long));
+                w->block_bases = realloc(w->block_bases, w->blocks_cap * sizeof(int));
+            }
+            w->block_offsets[w->num_blocks] = p - w->payload;
+            w->block_bases[w->num_blocks] = w->prev_end;
+            w->num_blocks++;
+        }
+        int gap = tokens[i].offset - w->prev_end;
+        p = put_varint(p, ((unsigned int)gap << 1) ^ (unsigned int)(gap >> 31));
+        p = put_varint(p, (unsigned int)tokens[i].length);
+        p = put_varint(p, (unsigned int)(tokens[i].rule + 1));
+        w->prev_end = tokens[i].offset + tokens[i].length;
+        w->num_tokens++;
+    }
+    w->payload_len = p - w->payload;
+}
+
+unsigned char* lex_stream_writer_finish(struct LexStreamWriter* w, size_t* size) {
+    size_t index_size = (size_t)w->num_blocks * LEX_STREAM_INDEX_ENTRY;
+    *size = LEX_STREAM_HEADER_SIZE + index_size + w->payload_len;
+    unsigned char* out = malloc(*size);
+    memcpy(out, lex_stream_magic, 4);
+    put_u32(out + 4, (unsigned int)w->num_tokens);
+    put_u32(out + 8, (unsigned int)w->block_size);
+    put_u32(out + 12, (unsigned int)w->num_blocks);
+    unsigned char* p = out + LEX_STREAM_HEADER_SIZE;
+    for (int b = 0; b < w->num_blocks; b++, p += LEX_STREAM_INDEX_ENTRY) {
+        put_u64(p, w->block_offsets[b]);
+        put_u32(p + 8, (unsigned int)w->block_bases[b]);
+    }
+    memcpy(p, w->payload, w->payload_len);
+    free(w->payload);
+    free(w->block_offsets);
+    free(w->block_bases);
+    free(w);
+    return out;
+}
+
+int write_lex_stream(FILE* out, const LexToken* tokens, int num_tokens, int block_size) {
+    struct LexStreamWriter* w = create_lex_stream_writer(block_size);
+    lex_stream_writer_add(w, tokens, num_tokens);
+    size_t size;
+    unsigned char* data = lex_stream_writer_finish(w, &size);
+    int ok = fwrite(data, 1, size, out) == size;
+    free(data);
+    return ok ? 0 : -1;
+}
+
+int lex_stream_open(struct LexStreamReader* r, const void* data, size_t size) {
+    const unsigned char* d = data;
+    if (size < LEX_STREAM_HEADER_SIZE || memcmp(d, lex_stream_magic, 4) != 0) return -1;
+    unsigned int num_tokens = get_u32(d + 4), block_size = get_u32(d + 8), num_blocks = get_u32(d + 12);
+    if (num_tokens > 0x7FFFFFFF || block_size > 0x7FFFFFFF) return -1;
+    unsigned long long expect = block_size ? ((unsigned long long)num_tokens + block_size - 1) / block_size : 0;
+    if (num_blocks != expect) return -1;
+    if ((size - LEX_STREAM_HEADER_SIZE) / LEX_STREAM_INDEX_ENTRY < num_blocks) return -1;
+    r->data = d;
+    r->size = size;
+    r->num_tokens = (int)num_tokens;
+    r->block_size = (int)block_size;
+    r->num_blocks = (int)num_blocks;
+    r->index = d + LEX_STREAM_HEADER_SIZE;
+    r->payload = r->index + (size_t)num_blocks * LEX_STREAM_INDEX_ENTRY;
+    r->cursor = r->payload;
+    r->next = 0;
+    r->prev_end = 0;
+    return 0;
+}
+
+int lex_stream_read(struct LexStreamReader* r, LexToken* tokens, int max_tokens) {
+    const unsigned char* p = r->cursor;
+    const unsigned char* end = r->data + r->size;
+    int count = r->num_tokens - r->next;
+    if (count > max_tokens) count = max_tokens;
+    int prev_end = r->prev_end;
+    for (int i = 0; i < count; i++) {
+        unsigned int gap, length, rule;
+        if (!get_varint(&p, end, &gap) || !get_varint(&p, end, &length) || !get_varint(&p, end, &rule)) return -1;
+        tokens[i].offset = prev_end + (int)((gap >> 1) ^ -(gap & 1));
+        tokens[i].length = (int)length;
+        tokens[i].rule = (int)rule - 1;
+        prev_end = tokens[i].offset + tokens[i].length;
+    }
+    r->cursor = p;
+    r->next += count;
+    r->prev_end = prev_end;
+    return count;
+}
+
+// 有索引时从所在块的开头解码，否则从头解码，逐个跳过前面的单元
+int lex_stream_seek(struct LexStreamReader* r, int token) {
+    if (token < 0 || token > r->num_tokens) return -1;
+    if (r->block_size && token < r->num_tokens) {
+        int block = token / r->block_size;
+        const unsigned char* entry = r->index + (size_t)block * LEX_STREAM_INDEX_ENTRY;
+        unsigned long long offset = get_u64(entry);
+        if (offset > (unsigned long long)(r->data + r->size - r->payload)) return -1;
+        r->cursor = r->payload + offset;
+        r->next = block * r->block_size;
+        r->prev_end = (int)get_u32(entry + 8);
+    } else if (token < r->next) {
+        r->cursor = r->payload;
+        r->next = 0;
+        r->prev_end = 0;
+    }
+    LexToken skipped[64];
+    while (r->next < token) {
+        int want = token - r->next < 64 ? token - r->next : 64;
+        if (lex_stream_read(r, skipped, want) != want) return -1;
+    }
+    return 0;
+}
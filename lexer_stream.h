@@ -0,0 +1,54 @@
+#ifndef LEXER_STREAM_H_INCLUDED
+#define LEXER_STREAM_H_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include "lexer.h"
+
+// 二进制词法单元流：每个单元依次写 (起点 - 上一个单元的终点) 的 zigzag 变长整数、长度与 rule + 1 的变长整数（LEB128），
+// 连续切分的单元间隔为 0，常见单元只占 3 个字节。可选的块索引每 block_size 个单元记一次载荷偏移与基准终点，
+// 每块都能单独解码，用于随机访问。读取端直接在调用者的缓冲区（例如 mmap 的文件）上解码，不复制数据。
+//
+// 布局（头部与索引中的整数均为小端）：
+//   "LXT1" | u32 num_tokens | u32 block_size | u32 num_blocks | num_blocks x (u64 载荷偏移, u32 基准终点) | 载荷
+#define LEX_STREAM_HEADER_SIZE 16
+#define LEX_STREAM_INDEX_ENTRY 12
+#define LEX_STREAM_DEFAULT_BLOCK 1024
+
+struct LexStreamWriter {
+    unsigned char* payload;
+    size_t payload_len;
+    size_t payload_cap;
+    unsigned long long* block_offsets;
+    int* block_bases;
+    int num_blocks;
+    int blocks_cap;
+    int block_size;    /* 0 writes no block index */
+    int num_tokens;
+    int prev_end;
+};
+
+struct LexStreamReader {
+    const unsigned char* data;
+    size_t size;
+    int num_tokens;
+    int block_size;
+    int num_blocks;
+    const unsigned char* index;
+    const unsigned char* payload;
+    const unsigned char* cursor;  /* next token to decode */
+    int next;                     /* its token number */
+    int prev_end;
+};
+
+struct LexStreamWriter* create_lex_stream_writer(int block_size);
+void lex_stream_writer_add(struct LexStreamWriter* w, const LexToken* tokens, int num_tokens);
+unsigned char* lex_stream_writer_finish(struct LexStreamWriter* w, size_t* size); /* frees w; the result is malloc'd */
+int write_lex_stream(FILE* out, const LexToken* tokens, int num_tokens, int block_size); /* 0 on success, -1 on a write error */
+
+// data 须在读取期间保持有效；格式不对返回 -1
+int lex_stream_open(struct LexStreamReader* r, const void* data, size_t size);
+int lex_stream_read(struct LexStreamReader* r, LexToken* tokens, int max_tokens); /* tokens decoded, -1 on truncated or corrupt data */
+int lex_stream_seek(struct LexStreamReader* r, int token);                      /* 0, or -1 when token is out of range or the index is broken */
+
+#endif // LEXER_STREAM_H_INCLUDED
@@ -4,8 +4,9 @@
 #include <time.h>
 #include "lang.h"
 #include "lexer.h"
+#include "lexer_cache.h"
 // 测试函数
-void test_lexer() {
+void test_lexer(int profile, const char* cache_dir) {
     printf("========== Compiler Principles Lexer Test ==========\n\n");
     
     int num_rules;
@@ -13,8 +14,16 @@ void test_lexer() {
     
     // Generate lexer
     printf("Generating lexer...\n");
-    struct Lexer* lexer = generate_lexer(regexps, num_rules);
+    struct LexerBuildReport report;
+    struct LexerOptions options = {0};
+    options.report = profile ? &report : NULL;
+    struct Lexer* lexer = generate_lexer_cached(regexps, num_rules, &options, cache_dir);
     printf("Lexer generation completed!\n\n");
+    if (profile) {
+        printf("========== Build Profile ==========\n");
+        print_lexer_build_report(&report, stdout);
+        printf("\n");
+    }
     
     // Test cases
     char* test_cases[] = {
@@ -38,7 +47,7 @@ void test_lexer() {
         int segments[100];
         int categories[100];
         
-        lexical_analysis(lexer->dfa, lexer->dfa_accepting_rules, test_cases[i], segments, categories);
+        lexer_tokenize(lexer, test_cases[i], segments, categories);
         print_lexical_result(test_cases[i], segments, categories);
     }
     
@@ -59,18 +68,33 @@ void test_lexer() {
         int segments[100];
         int categories[100];
         
-        lexical_analysis(lexer->dfa, lexer->dfa_accepting_rules, input, segments, categories);
+        lexer_tokenize(lexer, input, segments, categories);
         print_lexical_result(input, segments, categories);
     }
     
+#ifdef LEXER_STATS
+    if (lexer->stats) {
+        printf("========== Lexer Statistics ==========\n");
+        dump_lexer_stats_json(lexer->stats, stdout);
+    }
+#endif
+
     printf("Testing completed!\n");
     free(regexps);
 }
 
-int main() {
-   
+// lexer_test.exe --profile 额外打印生成词法分析器各阶段的耗时与规模
+// lexer_test.exe --cache <目录> 把编译好的 DFA 缓存在该目录，下次启动直接读回
+int main(int argc, char** argv) {
+    int profile = 0;
+    const char* cache_dir = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) profile = 1;
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) cache_dir = argv[++i];
+    }
+
     // Run functional tests
-    test_lexer();
+    test_lexer(profile, cache_dir);
     
     return 0;
 }
\ No newline at end of file
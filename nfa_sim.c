@@ -0,0 +1,96 @@
+#include "lexer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// NFA 模拟（不带捕获的 Pike VM）：同时推进所有 NFA 状态，每步代价与活跃状态数成正比，
+// 不需要确定化。当前状态集合恰好对应子集构造中的一个 DFA 状态，
+// 因此最长匹配与规则优先级和 lexical_analysis 完全一致。
+
+// 集合中编号最大的接受点决定规则，与 nfa_to_dfa 标记接受状态的方式相同
+static int set_accepting_rule(int* accept_rules, int* set, int size) {
+    int best = -1, rule = -1;
+    for (int i = 0; i < size; i++) {
+        int v = set[i];
+        if (accept_rules[v] != -1 && v > best) {
+            best = v;
+            rule = accept_rules[v];
+        }
+    }
+    return rule;
+}
+
+static inline void nfa_reset(void* ctx) {
+    struct NFACursor* cur = ctx;
+    memcpy(cur->current, cur->start_set, cur->start_size * sizeof(int));
+    cur->size = cur->start_size;
+    cur->rule = cur->start_rule;
+}
+
+static inline int nfa_step(void* ctx, unsigned char c) {
+    struct NFACursor* cur = ctx;
+    NFAIndex* idx = cur->idx;
+    int* mark = cur->mark;
+    int* next = cur->next;
+    int next_size = 0;
+    int stamp = ++cur->stamp;
+    for (int i = 0; i < cur->size; i++) {
+        int v = cur->current[i];
+        for (int k = idx->sym_start[v]; k < idx->sym_start[v + 1]; k++) {
+            int w = idx->sym_dst[k];
+            if (((idx->sym_bits[k][c >> 3] >> (c & 7)) & 1) && mark[w] != stamp) {
+                mark[w] = stamp;
+                next[next_size++] = w;
+            }
+        }
+    }
+    if (next_size == 0) return 0;
+    cur->size = nfa_index_closure(idx, next, next_size, mark, stamp);
+    cur->next = cur->current;
+    cur->current = next;
+    cur->rule = set_accepting_rule(cur->accept_rules, cur->current, cur->size);
+    return 1;
+}
+
+static inline int nfa_accept(void* ctx) {
+    return ((struct NFACursor*)ctx)->rule;
+}
+
+static const LexMunchOps nfa_ops = { nfa_reset, nfa_step, nfa_accept };
+
+void nfa_cursor_init(struct NFACursor* cur, NFAIndex* idx, int* accept_rules) {
+    int n = idx->n;
+    cur->idx = idx;
+    cur->accept_rules = accept_rules;
+    cur->start_set = malloc((n + 1) * sizeof(int));
+    cur->current = malloc((n + 1) * sizeof(int));
+    cur->next = malloc((n + 1) * sizeof(int));
+    cur->mark = calloc(n + 1, sizeof(int));
+    cur->stamp = 1;
+    cur->start_size = 0;
+    if (n > 0) {
+        cur->start_set[cur->start_size++] = 0;
+        cur->mark[0] = cur->stamp;
+        cur->start_size = nfa_index_closure(idx, cur->start_set, cur->start_size, cur->mark, cur->stamp);
+    }
+    cur->start_rule = set_accepting_rule(accept_rules, cur->start_set, cur->start_size);
+    cur->size = 0;
+    cur->rule = -1;
+}
+
+void nfa_cursor_free(struct NFACursor* cur) {
+    free(cur->start_set);
+    free(cur->current);
+    free(cur->next);
+    free(cur->mark);
+}
+
+int nfa_munch(struct NFACursor* cur, struct LexMunch* m, const char* input, int len, int eof) {
+    return lex_munch(&nfa_ops, cur, m, (const unsigned char*)input, len, eof);
+}
+
+void nfa_lexical_analysis(NFAIndex* idx, int* accept_rules, char* input, int* segments, int* categories) {
+    struct NFACursor cur;
+    nfa_cursor_init(&cur, idx, accept_rules);
+    lex_munch_segments(&nfa_ops, &cur, input, strlen(input), segments, categories);
+    nfa_cursor_free(&cur);
+}
@@ -0,0 +1,391 @@
+#include "regexp_unicode.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    unsigned int lo, hi;
+} CodeRange;
+
+// 一个码点区间段的 UTF-8 编码：第 i 个字节落在 [lo[i], hi[i]]
+typedef struct {
+    unsigned char lo[4], hi[4];
+    int len;
+} Utf8Seq;
+
+// 简单大小写折叠：[lo, hi] 内的码点加上 delta 得到另一种大小写（两个方向各一条）
+static const struct {
+    unsigned int lo, hi;
+    int delta;
+} fold_table[] = {
+    {0x0041, 0x005A, 32}, {0x0061, 0x007A, -32},     /* ASCII */
+    {0x00C0, 0x00D6, 32}, {0x00D8, 0x00DE, 32},      /* Latin-1, skipping U+00D7 */
+    {0x00E0, 0x00F6, -32}, {0x00F8, 0x00FE, -32},    /* and U+00F7 */
+    {0x0391, 0x03A1, 32}, {0x03A3, 0x03A9, 32},      /* Greek */
+    {0x03B1, 0x03C1, -32}, {0x03C3, 0x03C9, -32},
+    {0x03A3, 0x03A3, 31}, {0x03C2, 0x03C2, -31},     /* final sigma */
+    {0x03C2, 0x03C2, 1}, {0x03C3, 0x03C3, -1},
+    {0x0410, 0x042F, 32}, {0x0430, 0x044F, -32},     /* Cyrillic */
+    {0x0400, 0x040F, 80}, {0x0450, 0x045F, -80},
+};
+
+int utf8_encode(unsigned int cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | cp >> 6);
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp >= 0xD800 && cp <= 0xDFFF) return 0;
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | cp >> 12);
+        out[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    if (cp > UTF8_MAX_CODE_POINT) return 0;
+    out[0] = (char)(0xF0 | cp >> 18);
+    out[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+    out[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+int utf8_decode(const char* s, int len, unsigned int* cp) {
+    static const unsigned int min_cp[5] = {0, 0, 0x80, 0x800, 0x10000};
+    if (len <= 0) return 0;
+    unsigned char b = (unsigned char)s[0];
+    int n;
+    unsigned int x;
+    if (b < 0x80) {
+        *cp = b;
+        return 1;
+    } else if ((b & 0xE0) == 0xC0) {
+        n = 2;
+        x = b & 0x1F;
+    } else if ((b & 0xF0) == 0xE0) {
+        n = 3;
+        x = b & 0x0F;
+    } else if ((b & 0xF8) == 0xF0) {
+        n = 4;
+        x = b & 0x07;
+    } else {
+        return 0;
+    }
+    if (len < n) return 0;
+    for (int i = 1; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if ((c & 0xC0) != 0x80) return 0;
+        x = x << 6 | (c & 0x3F);
+    }
+    if (x < min_cp[n] || x > UTF8_MAX_CODE_POINT || (x >= 0xD800 && x <= 0xDFFF)) return 0;
+    *cp = x;
+    return n;
+}
+
+static int compare_range(const void* a, const void* b) {
+    const CodeRange* x = a;
+    const CodeRange* y = b;
+    if (x->lo != y->lo) return x->lo < y->lo ? -1 : 1;
+    return x->hi < y->hi ? -1 : x->hi > y->hi;
+}
+
+// 排序并合并重叠或相邻的区间，返回合并后的个数
+static int normalize_ranges(CodeRange* r, int n) {
+    if (n == 0) return 0;
+    qsort(r, n, sizeof(CodeRange), compare_range);
+    int m = 0;
+    for (int i = 1; i < n; i++) {
+        if (r[i].lo <= r[m].hi + 1) {
+            if (r[i].hi > r[m].hi) r[m].hi = r[i].hi;
+        } else {
+            r[++m] = r[i];
+        }
+    }
+    return m + 1;
+}
+
+// 每个区间与折叠表的每一项求交，平移后追加；*r 的容量须能放下 n * (折叠表项数 + 1) 个区间
+static int fold_ranges(CodeRange* r, int n) {
+    int m = n;
+    for (int i = 0; i < n; i++) {
+        for (size_t k = 0; k < sizeof(fold_table) / sizeof(fold_table[0]); k++) {
+            unsigned int lo = r[i].lo > fold_table[k].lo ? r[i].lo : fold_table[k].lo;
+            unsigned int hi = r[i].hi < fold_table[k].hi ? r[i].hi : fold_table[k].hi;
+            if (lo > hi) continue;
+            r[m].lo = lo + fold_table[k].delta;
+            r[m].hi = hi + fold_table[k].delta;
+            m++;
+        }
+    }
+    return normalize_ranges(r, m);
+}
+
+// [0, UTF8_MAX_CODE_POINT] 中不在 r 内的部分；r 已规范化，结果最多 n + 1 段
+static int negate_ranges(const CodeRange* r, int n, CodeRange* out) {
+    int m = 0;
+    unsigned int next = 0;
+    for (int i = 0; i < n; i++) {
+        if (r[i].lo > next) out[m++] = (CodeRange){next, r[i].lo - 1};
+        next = r[i].hi + 1;
+    }
+    if (next <= UTF8_MAX_CODE_POINT) out[m++] = (CodeRange){next, UTF8_MAX_CODE_POINT};
+    return m;
+}
+
+static void push_seq(Utf8Seq** seqs, int* n, int* cap, const Utf8Seq* s) {
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 16;
+        *seqs = realloc(*seqs, *cap * sizeof(Utf8Seq));
+    }
+    (*seqs)[(*n)++] = *s;
+}
+
+// utf8-ranges 的切分：先按编码长度的边界切开，再切到区间内除首字节外每个字节都能独立取满 [80, BF] 或一个子区间为止，
+// 这时首尾两个码点的编码逐字节给出各字节的区间
+static void split_utf8(unsigned int lo, unsigned int hi, Utf8Seq** seqs, int* n, int* cap) {
+    static const unsigned int length_max[3] = {0x7F, 0x7FF, 0xFFFF};
+    for (int i = 0; i < 3; i++) {
+        if (lo <= length_max[i] && length_max[i] < hi) {
+            split_utf8(lo, length_max[i], seqs, n, cap);
+            split_utf8(length_max[i] + 1, hi, seqs, n, cap);
+            return;
+        }
+    }
+    if (hi > 0x7F) {
+        for (int i = 1; i < 4; i++) {
+            unsigned int m = (1u << (6 * i)) - 1;
+            if ((lo & ~m) == (hi & ~m)) continue;
+            if (lo & m) {
+                split_utf8(lo, lo | m, seqs, n, cap);
+                split_utf8((lo | m) + 1, hi, seqs, n, cap);
+                return;
+            }
+            if ((hi & m) != m) {
+                split_utf8(lo, (hi & ~m) - 1, seqs, n, cap);
+                split_utf8(hi & ~m, hi, seqs, n, cap);
+                return;
+            }
+        }
+    }
+    char a[4], b[4];
+    Utf8Seq s;
+    s.len = utf8_encode(lo, a);
+    utf8_encode(hi, b);
+    for (int i = 0; i < s.len; i++) {
+        s.lo[i] = (unsigned char)a[i];
+        s.hi[i] = (unsigned char)b[i];
+    }
+    push_seq(seqs, n, cap, &s);
+}
+
+static struct frontend_regexp* byte_range_regexp(unsigned int lo, unsigned int hi) {
+    struct char_set* cs = malloc(sizeof(struct char_set));
+    cs->n = hi - lo + 1;
+    cs->c = malloc(cs->n);
+    for (unsigned int i = 0; i < cs->n; i++) cs->c[i] = (char)(lo + i);
+    return TFr_CharSet(cs);
+}
+
+static struct frontend_regexp* union_regexp(struct frontend_regexp* a, struct frontend_regexp* b) {
+    return a ? TFr_Union(a, b) : b;
+}
+
+// 按末尾字节区间排序，末尾相同的相邻
+static int compare_suffix(const void* a, const void* b) {
+    const Utf8Seq* x = a;
+    const Utf8Seq* y = b;
+    int kx = x->lo[x->len - 1] << 8 | x->hi[x->len - 1], ky = y->lo[y->len - 1] << 8 | y->hi[y->len - 1];
+    if (kx != ky) return kx < ky ? -1 : 1;
+    return x->len - y->len;
+}
+
+// 只剩一个字节的序列并成一个字符集；其余按末尾的字节区间分组，组内去掉末尾后递归，得到 (前缀的并) 接 [末尾]，
+// 同一个末尾区间在整棵正则里只出现一次
+static struct frontend_regexp* build_shared_suffix(Utf8Seq* seqs, int n) {
+    qsort(seqs, n, sizeof(Utf8Seq), compare_suffix);
+    bool present[256] = {false};
+    char singles[256];
+    int num_singles = 0;
+    struct frontend_regexp* result = NULL;
+    for (int i = 0; i < n;) {
+        if (seqs[i].len == 1) {
+            for (unsigned int c = seqs[i].lo[0]; c <= seqs[i].hi[0]; c++) {
+                if (!present[c]) singles[num_singles++] = (char)c;
+                present[c] = true;
+            }
+            i++;
+            continue;
+        }
+        unsigned char lo = seqs[i].lo[seqs[i].len - 1], hi = seqs[i].hi[seqs[i].len - 1];
+        int j = i;
+        while (j < n && seqs[j].len > 1 && seqs[j].lo[seqs[j].len - 1] == lo && seqs[j].hi[seqs[j].len - 1] == hi) {
+            seqs[j].len--;
+            j++;
+        }
+        struct frontend_regexp* prefix = build_shared_suffix(seqs + i, j - i);
+        result = union_regexp(result, TFr_Concat(prefix, byte_range_regexp(lo, hi)));
+        i = j;
+    }
+    if (num_singles) result = union_regexp(result, TFr_CharSet(create_char_set_from_chars(singles, num_singles)));
+    return result;
+}
+
+struct frontend_regexp* utf8_class_regexp(const unsigned int* ranges, int num_ranges, int flags) {
+    int entries = sizeof(fold_table) / sizeof(fold_table[0]);
+    // 去掉代理区最多把每段拆成两段，折叠再追加每项一段，取反多一段
+    int cap = 2 * num_ranges * (entries + 1) + 2;
+    CodeRange* r = malloc(cap * sizeof(CodeRange));
+    int n = 0;
+    for (int i = 0; i < num_ranges; i++) {
+        unsigned int lo = ranges[2 * i], hi = ranges[2 * i + 1];
+        if (hi > UTF8_MAX_CODE_POINT) hi = UTF8_MAX_CODE_POINT;
+        if (lo > hi) continue;
+        if (lo < 0xD800 && hi > 0xDFFF) {
+            r[n++] = (CodeRange){lo, 0xD7FF};
+            r[n++] = (CodeRange){0xE000, hi};
+        } else if (lo >= 0xD800 && hi <= 0xDFFF) {
+            continue;
+        } else {
+            r[n++] = (CodeRange){lo >= 0xD800 && lo <= 0xDFFF ? 0xE000 : lo, hi >= 0xD800 && hi <= 0xDFFF ? 0xD7FF : hi};
+        }
+    }
+    n = normalize_ranges(r, n);
+    if (flags & UTF8_CLASS_FOLD_CASE) n = fold_ranges(r, n);
+    if (flags & UTF8_CLASS_NEGATE) {
+        CodeRange* neg = malloc((n + 2) * sizeof(CodeRange));
+        n = negate_ranges(r, n, neg);
+        free(r);
+        r = neg;
+    }
+
+    Utf8Seq* seqs = NULL;
+    int num_seqs = 0, seqs_cap = 0;
+    for (int i = 0; i < n; i++) {
+        // 取反后的区间可能覆盖代理区
+        if (r[i].lo < 0xD800 && r[i].hi > 0xDFFF) {
+            split_utf8(r[i].lo, 0xD7FF, &seqs, &num_seqs, &seqs_cap);
+            split_utf8(0xE000, r[i].hi, &seqs, &num_seqs, &seqs_cap);
+        } else if (r[i].lo > 0xDFFF || r[i].hi < 0xD800) {
+            split_utf8(r[i].lo, r[i].hi, &seqs, &num_seqs, &seqs_cap);
+        } else {
+            if (r[i].lo < 0xD800) split_utf8(r[i].lo, 0xD7FF, &seqs, &num_seqs, &seqs_cap);
+            if (r[i].hi > 0xDFFF) split_utf8(0xE000, r[i].hi, &seqs, &num_seqs, &seqs_cap);
+        }
+    }
+    free(r);
+    struct frontend_regexp* result = num_seqs ? build_shared_suffix(seqs, num_seqs) : NULL;
+    free(seqs);
+    return result;
+}
+
+static struct frontend_regexp* concat_regexp(struct frontend_regexp* a, struct frontend_regexp* b) {
+    return a ? TFr_Concat(a, b) : b;
+}
+
+// 攒下的不需折叠的字节作为一段字符串接到结果后面
+static struct frontend_regexp* flush_literal(struct frontend_regexp* result, char* buf, int* len) {
+    if (*len == 0) return result;
+    buf[*len] = '\0';
+    *len = 0;
+    return concat_regexp(result, TFr_String(buf));
+}
+
+// 字符串逐码点折叠：有另一种大小写的码点换成它的字符类，其余字节（包括不合法的 UTF-8）原样保留
+static struct frontend_regexp* fold_string(const char* s) {
+    int len = strlen(s);
+    char* buf = malloc(len + 1);
+    int buf_len = 0;
+    struct frontend_regexp* result = NULL;
+    for (int i = 0; i < len;) {
+        unsigned int cp;
+        int n = utf8_decode(s + i, len - i, &cp);
+        if (n == 0) {
+            buf[buf_len++] = s[i++];
+            continue;
+        }
+        CodeRange r[sizeof(fold_table) / sizeof(fold_table[0]) + 1] = {{cp, cp}};
+        if (fold_ranges(r, 1) == 1 && r[0].lo == r[0].hi) {
+            memcpy(buf + buf_len, s + i, n);
+            buf_len += n;
+        } else {
+            result = flush_literal(result, buf, &buf_len);
+            unsigned int range[2] = {cp, cp};
+            result = concat_regexp(result, utf8_class_regexp(range, 1, UTF8_CLASS_FOLD_CASE));
+        }
+        i += n;
+    }
+    result = flush_literal(result, buf, &buf_len);
+    free(buf);
+    return result ? result : TFr_String("");
+}
+
+static char other_case(char c) {
+    if (c >= 'a' && c <= 'z') return c - 'a' + 'A';
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 'a';
+    return c;
+}
+
+struct frontend_regexp* fold_case_regexp(struct frontend_regexp* fr) {
+    switch (fr->t) {
+        case T_FR_CHAR_SET: {
+            bool present[256] = {false};
+            char chars[256];
+            int n = 0;
+            for (unsigned int i = 0; i < fr->d.CHAR_SET.n; i++) {
+                unsigned char c = (unsigned char)fr->d.CHAR_SET.c[i];
+                if (!present[c]) chars[n++] = (char)c;
+                present[c] = true;
+            }
+            for (int i = 0, m = n; i < m; i++) {
+                unsigned char c = (unsigned char)other_case(chars[i]);
+                if (!present[c]) chars[n++] = (char)c;
+                present[c] = true;
+            }
+            return TFr_CharSet(create_char_set_from_chars(chars, n));
+        }
+        case T_FR_SINGLE_CHAR: {
+            char c = fr->d.SINGLE_CHAR.c;
+            if (other_case(c) == c) return TFr_SingleChar(c);
+            char chars[2] = {c, other_case(c)};
+            return TFr_CharSet(create_char_set_from_chars(chars, 2));
+        }
+        case T_FR_STRING:
+            return fold_string(fr->d.STRING.s);
+        case T_FR_OPTIONAL:
+            return TFr_Option(fold_case_regexp(fr->d.OPTION.r));
+        case T_FR_STAR:
+            return TFr_Star(fold_case_regexp(fr->d.STAR.r));
+        case T_FR_PLUS:
+            return TFr_Plus(fold_case_regexp(fr->d.PLUS.r));
+        case T_FR_UNION:
+            return TFr_Union(fold_case_regexp(fr->d.UNION.r1), fold_case_regexp(fr->d.UNION.r2));
+        case T_FR_CONCAT:
+            return TFr_Concat(fold_case_regexp(fr->d.CONCAT.r1), fold_case_regexp(fr->d.CONCAT.r2));
+    }
+    return NULL;
+}
+
+struct frontend_regexp** fold_rule_cases(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options) {
+    if (!options || !options->rule_attrs) return NULL;
+    struct frontend_regexp** folded = NULL;
+    for (int i = 0; i < num_regexps; i++) {
+        if (!options->rule_attrs[i].fold_case) continue;
+        if (!folded) {
+            folded = malloc(num_regexps * sizeof(struct frontend_regexp*));
+            memcpy(folded, regexps, num_regexps * sizeof(struct frontend_regexp*));
+        }
+        folded[i] = fold_case_regexp(regexps[i]);
+    }
+    return folded;
+}
+
+void free_folded_rules(struct frontend_regexp** folded, struct frontend_regexp** regexps, int num_regexps) {
+    if (!folded) return;
+    for (int i = 0; i < num_regexps; i++) {
+        if (folded[i] != regexps[i]) free_frontend_regexp(folded[i]);
+    }
+    free(folded);
+}
@@ -0,0 +1,32 @@
+#ifndef REGEXP_UNICODE_H_INCLUDED
+#define REGEXP_UNICODE_H_INCLUDED
+
+#include "lexer.h"
+
+// Unicode 字符类与大小写折叠：自动机始终按字节转移，码点区间在构造正则时就展开成 UTF-8 字节序列的正则
+// （做法同 RE2 / utf8-ranges：按编码长度与续字节边界切分区间，每段是逐字节区间的序列），
+// 各序列按末尾的字节区间合并公共后缀，子集构造后读完前缀的状态会落到同一组 NFA 状态上，DFA 不会按首字节分裂出成串的重复状态。
+// 大小写折叠是简单的一对一折叠：ASCII、Latin-1、希腊字母与西里尔字母
+#define UTF8_MAX_CODE_POINT 0x10FFFF
+
+#define UTF8_CLASS_NEGATE 1      /* match every code point outside the ranges */
+#define UTF8_CLASS_FOLD_CASE 2   /* add the other case of every code point first */
+
+// 写入 cp 的 UTF-8 编码，返回字节数；代理区与超出范围的码点返回 0
+int utf8_encode(unsigned int cp, char* out);
+// 解码 s[0, len) 开头的一个码点，返回消耗的字节数；编码不合法（截断、过长、代理区）时返回 0
+int utf8_decode(const char* s, int len, unsigned int* cp);
+
+// ranges 为 num_ranges 对闭区间 (lo, hi)，可以无序、重叠；代理区不可编码，直接去掉。
+// 结果只匹配区间内码点的合法编码；区间为空（例如取反后）时返回 NULL，因为空字符集在自动机里表示 epsilon 边
+struct frontend_regexp* utf8_class_regexp(const unsigned int* ranges, int num_ranges, int flags);
+
+// 大小写折叠后的深拷贝：字符集与单字符补上 ASCII 字母的另一种大小写，字符串按码点折叠。
+// 字节级字符集里的非 ASCII 字节无法还原成码点，不折叠；非 ASCII 的字符类应以 UTF8_CLASS_FOLD_CASE 构造
+struct frontend_regexp* fold_case_regexp(struct frontend_regexp* fr);
+
+// options->rule_attrs 中 fold_case 的规则换成折叠后的副本，其余规则原样共用；没有这样的规则时返回 NULL
+struct frontend_regexp** fold_rule_cases(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options);
+void free_folded_rules(struct frontend_regexp** folded, struct frontend_regexp** regexps, int num_regexps);
+
+#endif // REGEXP_UNICODE_H_INCLUDED
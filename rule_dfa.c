@@ -0,0 +1,601 @@
+#include "rule_dfa.h"
+#include "lexer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ==================== 规则的规范形式 ====================
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} KeyBuffer;
+
+static void key_put(KeyBuffer* kb, const void* bytes, size_t n) {
+    if (kb->len + n > kb->cap) {
+        while (kb->len + n > kb->cap) kb->cap = kb->cap ? kb->cap * 2 : 64;
+        kb->data = realloc(kb->data, kb->cap);
+    }
+    memcpy(kb->data + kb->len, bytes, n);
+    kb->len += n;
+}
+
+static void key_put_tag(KeyBuffer* kb, char tag) {
+    key_put(kb, &tag, 1);
+}
+
+static void canonical_into(KeyBuffer* kb, struct frontend_regexp* fr) {
+    switch (fr->t) {
+    case T_FR_CHAR_SET: {
+        unsigned char bits[32] = {0};
+        for (unsigned int i = 0; i < fr->d.CHAR_SET.n; i++) {
+            unsigned char c = (unsigned char)fr->d.CHAR_SET.c[i];
+            bits[c >> 3] |= (unsigned char)(1u << (c & 7));
+        }
+        key_put_tag(kb, 'C');
+        key_put(kb, bits, sizeof(bits));
+        break;
+    }
+    case T_FR_OPTIONAL:
+        key_put_tag(kb, '?');
+        canonical_into(kb, fr->d.OPTION.r);
+        break;
+    case T_FR_STAR:
+        key_put_tag(kb, '*');
+        canonical_into(kb, fr->d.STAR.r);
+        break;
+    case T_FR_PLUS:
+        key_put_tag(kb, '+');
+        canonical_into(kb, fr->d.PLUS.r);
+        break;
+    case T_FR_STRING: {
+        unsigned int n = (unsigned int)strlen(fr->d.STRING.s);
+        key_put_tag(kb, 'S');
+        key_put(kb, &n, sizeof(n));
+        key_put(kb, fr->d.STRING.s, n);
+        break;
+    }
+    case T_FR_SINGLE_CHAR:
+        key_put_tag(kb, 'c');
+        key_put(kb, &fr->d.SINGLE_CHAR.c, 1);
+        break;
+    case T_FR_UNION:
+        key_put_tag(kb, '|');
+        canonical_into(kb, fr->d.UNION.r1);
+        canonical_into(kb, fr->d.UNION.r2);
+        break;
+    case T_FR_CONCAT:
+        key_put_tag(kb, '.');
+        canonical_into(kb, fr->d.CONCAT.r1);
+        canonical_into(kb, fr->d.CONCAT.r2);
+        break;
+    }
+}
+
+char* canonical_regexp(struct frontend_regexp* fr, size_t* len) {
+    KeyBuffer kb = {0};
+    canonical_into(&kb, fr);
+    *len = kb.len;
+    return kb.data;
+}
+
+static unsigned int hash_bytes(const char* s, size_t len) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// ==================== 规则缓存 ====================
+
+struct RuleDFACache* create_rule_dfa_cache(void) {
+    struct RuleDFACache* cache = calloc(1, sizeof(struct RuleDFACache));
+    cache->num_slots = 64;
+    cache->slots = malloc(cache->num_slots * sizeof(int));
+    for (int i = 0; i < cache->num_slots; i++) cache->slots[i] = -1;
+    cache->max_memory = RULE_DFA_CACHE_DEFAULT_MAX_MEMORY;
+    return cache;
+}
+
+void free_rule_dfa_cache(struct RuleDFACache* cache) {
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->keys[i]);
+        free_dfa_table(cache->dfas[i]);
+    }
+    free(cache->keys);
+    free(cache->key_lens);
+    free(cache->hashes);
+    free(cache->dfas);
+    free(cache->last_used);
+    free(cache->slots);
+    free(cache);
+}
+
+static int cache_find(struct RuleDFACache* cache, const char* key, size_t len, unsigned int hash) {
+    unsigned int h = hash & (cache->num_slots - 1);
+    while (cache->slots[h] != -1) {
+        int id = cache->slots[h];
+        if (cache->hashes[id] == hash && cache->key_lens[id] == len && memcmp(cache->keys[id], key, len) == 0) return id;
+        h = (h + 1) & (cache->num_slots - 1);
+    }
+    return -1;
+}
+
+static void cache_rehash(struct RuleDFACache* cache) {
+    for (int i = 0; i < cache->num_slots; i++) cache->slots[i] = -1;
+    for (int id = 0; id < cache->count; id++) {
+        unsigned int h = cache->hashes[id] & (cache->num_slots - 1);
+        while (cache->slots[h] != -1) h = (h + 1) & (cache->num_slots - 1);
+        cache->slots[h] = id;
+    }
+}
+
+// key 的所有权转移给缓存
+static void cache_insert(struct RuleDFACache* cache, char* key, size_t len, unsigned int hash, struct DFATable* dfa) {
+    if ((cache->count + 1) * 2 > cache->num_slots) {
+        free(cache->slots);
+        cache->num_slots *= 2;
+        cache->slots = malloc(cache->num_slots * sizeof(int));
+        cache_rehash(cache);
+    }
+    if (cache->count == cache->cap) {
+        cache->cap = cache->cap ? cache->cap * 2 : 16;
+        cache->keys = realloc(cache->keys, cache->cap * sizeof(char*));
+        cache->key_lens = realloc(cache->key_lens, cache->cap * sizeof(size_t));
+        cache->hashes = realloc(cache->hashes, cache->cap * sizeof(unsigned int));
+        cache->dfas = realloc(cache->dfas, cache->cap * sizeof(struct DFATable*));
+        cache->last_used = realloc(cache->last_used, cache->cap * sizeof(unsigned long long));
+    }
+    int id = cache->count++;
+    cache->keys[id] = key;
+    cache->key_lens[id] = len;
+    cache->hashes[id] = hash;
+    cache->dfas[id] = dfa;
+    cache->last_used[id] = cache->builds;
+    cache->memory += dfa_table_memory(dfa);
+    unsigned int h = hash & (cache->num_slots - 1);
+    while (cache->slots[h] != -1) h = (h + 1) & (cache->num_slots - 1);
+    cache->slots[h] = id;
+}
+
+typedef struct {
+    unsigned long long last_used;
+    int id;
+} CacheAge;
+
+static int compare_cache_age(const void* a, const void* b) {
+    const CacheAge* x = a;
+    const CacheAge* y = b;
+    if (x->last_used != y->last_used) return x->last_used < y->last_used ? -1 : 1;
+    return x->id - y->id;
+}
+
+// 超出 max_memory 时从最久没用过的表开始淘汰，直到回到限额以内；本次构造用到的表即使超额也保留
+static void cache_evict(struct RuleDFACache* cache) {
+    if (cache->memory <= cache->max_memory) return;
+    CacheAge* ages = malloc((cache->count + 1) * sizeof(CacheAge));
+    int num_old = 0;
+    for (int id = 0; id < cache->count; id++) {
+        if (cache->last_used[id] == cache->builds) continue;
+        ages[num_old].last_used = cache->last_used[id];
+        ages[num_old].id = id;
+        num_old++;
+    }
+    qsort(ages, num_old, sizeof(CacheAge), compare_cache_age);
+    for (int i = 0; i < num_old && cache->memory > cache->max_memory; i++) {
+        int id = ages[i].id;
+        cache->memory -= dfa_table_memory(cache->dfas[id]);
+        free_dfa_table(cache->dfas[id]);
+        free(cache->keys[id]);
+        cache->dfas[id] = NULL;
+        cache->evictions++;
+    }
+    free(ages);
+    int count = 0;
+    for (int id = 0; id < cache->count; id++) {
+        if (!cache->dfas[id]) continue;
+        cache->keys[count] = cache->keys[id];
+        cache->key_lens[count] = cache->key_lens[id];
+        cache->hashes[count] = cache->hashes[id];
+        cache->dfas[count] = cache->dfas[id];
+        cache->last_used[count] = cache->last_used[id];
+        count++;
+    }
+    cache->count = count;
+    cache_rehash(cache);
+}
+
+struct DFATable* compile_rule_dfa(struct frontend_regexp* fr, int max_states, size_t max_memory) {
+    struct finite_automata* nfa = build_nfa_from_regexp(simplify_regexp(fr));
+    int accept = nfa->n - 1;
+    int* rules = NULL;
+    struct finite_automata* dfa = nfa_to_dfa_bounded(nfa, &accept, 1, &rules, max_states, max_memory);
+    free_finite_automata(nfa);
+    if (!dfa) return NULL;
+    struct DFATable* table = build_dfa_table(dfa, rules);
+    free_finite_automata(dfa);
+    free(rules);
+    return table;
+}
+
+// ==================== 线程池编译 ====================
+
+typedef struct {
+    struct frontend_regexp** regexps; /* the rules to compile */
+    struct DFATable** results;
+    int count;
+    atomic_int next;
+    int max_states;
+    size_t max_memory;
+} CompileJobs;
+
+static void* compile_worker(void* arg) {
+    CompileJobs* jobs = arg;
+    int i;
+    while ((i = atomic_fetch_add(&jobs->next, 1)) < jobs->count) {
+        jobs->results[i] = compile_rule_dfa(jobs->regexps[i], jobs->max_states, jobs->max_memory);
+    }
+    return NULL;
+}
+
+static void compile_all(CompileJobs* jobs, int num_threads) {
+    if (num_threads > jobs->count) num_threads = jobs->count;
+    if (num_threads < 1) num_threads = 1;
+    atomic_store(&jobs->next, 0);
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    for (int t = 1; t < num_threads; t++) pthread_create(&threads[t], NULL, compile_worker, jobs);
+    compile_worker(jobs);
+    for (int t = 1; t < num_threads; t++) pthread_join(threads[t], NULL);
+    free(threads);
+}
+
+// ==================== 乘积构造 ====================
+
+// 乘积状态是 (规则, 该规则 DFA 的状态) 对的有序列表，只记录尚未死掉的规则
+typedef struct {
+    int** tuples;   /* pairs rule0, state0, rule1, state1, ... with ascending rules */
+    int* lens;      /* number of ints in tuples[id] */
+    int count;
+    int cap;
+    int* slots;
+    int num_slots;
+    size_t memory;
+} ProductTable;
+
+static unsigned int hash_tuple(const int* t, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned int)t[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int intern_tuple(ProductTable* pt, const int* t, int len, int* is_new) {
+    if ((pt->count + 1) * 2 > pt->num_slots) {
+        int new_slots = pt->num_slots ? pt->num_slots * 2 : 256;
+        int* slots = malloc(new_slots * sizeof(int));
+        for (int i = 0; i < new_slots; i++) slots[i] = -1;
+        for (int id = 0; id < pt->count; id++) {
+            unsigned int h = hash_tuple(pt->tuples[id], pt->lens[id]) & (new_slots - 1);
+            while (slots[h] != -1) h = (h + 1) & (new_slots - 1);
+            slots[h] = id;
+        }
+        free(pt->slots);
+        pt->slots = slots;
+        pt->num_slots = new_slots;
+    }
+    unsigned int h = hash_tuple(t, len) & (pt->num_slots - 1);
+    while (pt->slots[h] != -1) {
+        int id = pt->slots[h];
+        if (pt->lens[id] == len && memcmp(pt->tuples[id], t, len * sizeof(int)) == 0) {
+            *is_new = 0;
+            return id;
+        }
+        h = (h + 1) & (pt->num_slots - 1);
+    }
+    if (pt->count == pt->cap) {
+        pt->cap = pt->cap ? pt->cap * 2 : 64;
+        pt->tuples = realloc(pt->tuples, pt->cap * sizeof(int*));
+        pt->lens = realloc(pt->lens, pt->cap * sizeof(int));
+    }
+    int id = pt->count++;
+    pt->tuples[id] = malloc((len + 1) * sizeof(int));
+    memcpy(pt->tuples[id], t, len * sizeof(int));
+    pt->lens[id] = len;
+    pt->slots[h] = id;
+    pt->memory += len * sizeof(int) + sizeof(int*) + sizeof(int);
+    *is_new = 1;
+    return id;
+}
+
+static void free_product_table(ProductTable* pt) {
+    for (int i = 0; i < pt->count; i++) free(pt->tuples[i]);
+    free(pt->tuples);
+    free(pt->lens);
+    free(pt->slots);
+}
+
+// ==================== 乘积状态的备忘 ====================
+
+struct ProductMemo* create_product_memo(void) {
+    return calloc(1, sizeof(struct ProductMemo));
+}
+
+static void clear_product_memo(struct ProductMemo* memo) {
+    for (int i = 0; i < memo->count; i++) free(memo->tuples[i]);
+    free(memo->tuples);
+    free(memo->lens);
+    free(memo->slots);
+    free(memo->rows);
+    memo->tuples = NULL;
+    memo->lens = NULL;
+    memo->slots = NULL;
+    memo->rows = NULL;
+    memo->count = 0;
+    memo->num_slots = 0;
+}
+
+void free_product_memo(struct ProductMemo* memo) {
+    if (!memo) return;
+    clear_product_memo(memo);
+    free(memo);
+}
+
+static int memo_find(struct ProductMemo* memo, const int* t, int len) {
+    if (memo->count == 0) return -1;
+    unsigned int h = hash_tuple(t, len) & (memo->num_slots - 1);
+    while (memo->slots[h] != -1) {
+        int id = memo->slots[h];
+        if (memo->lens[id] == len && memcmp(memo->tuples[id], t, len * sizeof(int)) == 0) return id;
+        h = (h + 1) & (memo->num_slots - 1);
+    }
+    return -1;
+}
+
+// 元组里记的是规则的稳定编号而不是下标：规则增删后下标会变，编号不变，上一次构造的元组仍然有效
+static struct finite_automata* product_construction(struct DFATable** dfas, const int* rule_ids, int n, struct ProductMemo* memo,
+                                                    int max_states, size_t max_memory, int** dfa_accepting_rules) {
+    int max_id = 0;
+    for (int i = 0; i < n; i++) {
+        if (rule_ids[i] > max_id) max_id = rule_ids[i];
+    }
+    int* pos = malloc((max_id + 1) * sizeof(int)); /* rule index of every stable id */
+    for (int i = 0; i < n; i++) pos[rule_ids[i]] = i;
+
+    struct finite_automata* dfa = create_empty_graph();
+    ProductTable pt = {0};
+    int* buf = malloc((2 * n + 1) * sizeof(int));
+    int is_new;
+    for (int i = 0; i < n; i++) {
+        buf[2 * i] = rule_ids[i];
+        buf[2 * i + 1] = 0;
+    }
+    intern_tuple(&pt, buf, 2 * n, &is_new);
+    add_one_vertex(dfa);
+    int worklist_cap = 64, worklist_count = 0;
+    int* worklist = malloc(worklist_cap * sizeof(int));
+    worklist[worklist_count++] = 0;
+
+    // 有备忘时记录每个新状态对应的旧状态，以及本次构造的转移行，供下一次构造使用
+    int map_cap = 0, rows_cap = 0;
+    int* from_memo = NULL;   /* old state of every new state, or -1 */
+    int* old_to_new = NULL;  /* new state of every old state, or -1 */
+    int* rows = NULL;
+    if (memo) {
+        map_cap = 64;
+        from_memo = malloc(map_cap * sizeof(int));
+        from_memo[0] = memo_find(memo, buf, 2 * n);
+        old_to_new = malloc((memo->count + 1) * sizeof(int));
+        for (int i = 0; i < memo->count; i++) old_to_new[i] = -1;
+        if (from_memo[0] >= 0) old_to_new[from_memo[0]] = 0;
+        rows_cap = 64;
+        rows = malloc((size_t)rows_cap * 256 * sizeof(int));
+    }
+
+    int byte_target[256];
+    bool over_budget = false;
+    while (worklist_count > 0 && !over_budget) {
+        int current = worklist[--worklist_count];
+        int old = from_memo ? from_memo[current] : -1;
+        for (int c = 0; c < 256; c++) {
+            byte_target[c] = -1;
+            int id, matched = -1;
+            if (old >= 0) {
+                // 旧状态的转移行直接换成新编号，不必逐条规则推进
+                int target = memo->rows[(size_t)old * 256 + c];
+                if (target == -1) continue;
+                id = old_to_new[target];
+                is_new = 0;
+                if (id == -1) {
+                    id = intern_tuple(&pt, memo->tuples[target], memo->lens[target], &is_new);
+                    old_to_new[target] = id;
+                    matched = target;
+                }
+            } else {
+                // pt.tuples 可能在插入时 realloc，每次重新取指针
+                const int* t = pt.tuples[current];
+                int len = pt.lens[current], size = 0;
+                for (int k = 0; k < len; k += 2) {
+                    int next = dfas[pos[t[k]]]->next[(size_t)t[k + 1] * 256 + c];
+                    if (next != -1) {
+                        buf[size++] = t[k];
+                        buf[size++] = next;
+                    }
+                }
+                if (size == 0) continue;
+                id = intern_tuple(&pt, buf, size, &is_new);
+                if (is_new && memo) {
+                    matched = memo_find(memo, buf, size);
+                    if (matched >= 0) old_to_new[matched] = id;
+                }
+            }
+            if (is_new) {
+                if ((max_states > 0 && pt.count > max_states) || (max_memory > 0 && pt.memory > max_memory)) {
+                    over_budget = true;
+                    break;
+                }
+                add_one_vertex(dfa);
+                if (worklist_count == worklist_cap) {
+                    worklist_cap *= 2;
+                    worklist = realloc(worklist, worklist_cap * sizeof(int));
+                }
+                worklist[worklist_count++] = id;
+                if (from_memo) {
+                    if (id >= map_cap) {
+                        map_cap *= 2;
+                        from_memo = realloc(from_memo, map_cap * sizeof(int));
+                    }
+                    from_memo[id] = matched;
+                }
+            }
+            byte_target[c] = id;
+        }
+        if (over_budget) break;
+        if (rows && current < LEXER_DENSE_TABLE_MAX_STATES) {
+            while (current >= rows_cap) {
+                rows_cap *= 2;
+                rows = realloc(rows, (size_t)rows_cap * 256 * sizeof(int));
+            }
+            memcpy(rows + (size_t)current * 256, byte_target, sizeof(byte_target));
+        }
+        add_grouped_edges(dfa, current, byte_target);
+    }
+    free(worklist);
+    free(buf);
+    free(old_to_new);
+    if (over_budget) {
+        free(pos);
+        free(from_memo);
+        free(rows);
+        free_product_table(&pt);
+        free_finite_automata(dfa);
+        *dfa_accepting_rules = NULL;
+        return NULL;
+    }
+
+    // 元组中接受的规则下标最大者胜出，与合并 NFA 中接受点编号最大者胜出一致
+    int* rules = malloc((pt.count + 1) * sizeof(int));
+    for (int id = 0; id < pt.count; id++) {
+        rules[id] = -1;
+        for (int k = 0; k < pt.lens[id]; k += 2) {
+            int r = pos[pt.tuples[id][k]];
+            if (dfas[r]->accept[pt.tuples[id][k + 1]] != -1 && r > rules[id]) rules[id] = r;
+        }
+    }
+    *dfa_accepting_rules = rules;
+    free(pos);
+
+    // 本次的状态与转移行替换备忘；状态太多时整张放弃，下一次构造从头计算
+    if (memo) {
+        clear_product_memo(memo);
+        memo->reused = 0;
+        for (int id = 0; id < pt.count; id++) memo->reused += from_memo[id] >= 0;
+        if (pt.count <= LEXER_DENSE_TABLE_MAX_STATES) {
+            memo->tuples = pt.tuples;
+            memo->lens = pt.lens;
+            memo->slots = pt.slots;
+            memo->num_slots = pt.num_slots;
+            memo->count = pt.count;
+            memo->rows = rows;
+            pt.tuples = NULL;
+            pt.lens = NULL;
+            pt.slots = NULL;
+            pt.count = 0;
+            rows = NULL;
+        }
+    }
+    free(from_memo);
+    free(rows);
+    free_product_table(&pt);
+    return dfa;
+}
+
+struct finite_automata* build_product_dfa(struct frontend_regexp** regexps, int num_regexps, struct RuleDFACache* cache, int num_threads,
+                                          const int* rule_ids, struct ProductMemo* memo, int max_states, size_t max_memory,
+                                          int** dfa_accepting_rules) {
+    *dfa_accepting_rules = NULL;
+    if (num_regexps <= 0) return NULL;
+    char** keys = malloc(num_regexps * sizeof(char*));
+    size_t* lens = malloc(num_regexps * sizeof(size_t));
+    unsigned int* hashes = malloc(num_regexps * sizeof(unsigned int));
+    int* entry = malloc(num_regexps * sizeof(int));   /* cache entry of rule i, or -1 - (index into missing) */
+    struct frontend_regexp** missing = malloc(num_regexps * sizeof(struct frontend_regexp*));
+    int* missing_rule = malloc(num_regexps * sizeof(int));
+    int num_missing = 0;
+    cache->builds++;
+
+    // 查缓存；同一规则集里重复的规则只编译一次
+    for (int i = 0; i < num_regexps; i++) {
+        keys[i] = canonical_regexp(regexps[i], &lens[i]);
+        hashes[i] = hash_bytes(keys[i], lens[i]);
+        entry[i] = cache_find(cache, keys[i], lens[i], hashes[i]);
+        if (entry[i] >= 0) {
+            cache->hits++;
+            cache->last_used[entry[i]] = cache->builds;
+            continue;
+        }
+        int duplicate = -1;
+        for (int j = 0; j < num_missing && duplicate < 0; j++) {
+            int r = missing_rule[j];
+            if (hashes[r] == hashes[i] && lens[r] == lens[i] && memcmp(keys[r], keys[i], lens[i]) == 0) duplicate = j;
+        }
+        if (duplicate >= 0) {
+            entry[i] = -1 - duplicate;
+            continue;
+        }
+        cache->misses++;
+        entry[i] = -1 - num_missing;
+        missing_rule[num_missing] = i;
+        missing[num_missing++] = regexps[i];
+    }
+
+    CompileJobs jobs = {0};
+    jobs.regexps = missing;
+    jobs.results = calloc(num_missing + 1, sizeof(struct DFATable*));
+    jobs.count = num_missing;
+    jobs.max_states = max_states;
+    jobs.max_memory = max_memory;
+    if (num_missing > 0) compile_all(&jobs, num_threads);
+
+    // 编译成功的规则都进缓存，即使别的规则超出了预算
+    bool failed = false;
+    for (int j = 0; j < num_missing; j++) {
+        int r = missing_rule[j];
+        if (!jobs.results[j]) {
+            failed = true;
+            continue;
+        }
+        cache_insert(cache, keys[r], lens[r], hashes[r], jobs.results[j]);
+        keys[r] = NULL;
+    }
+
+    struct finite_automata* dfa = NULL;
+    if (!failed) {
+        struct DFATable** dfas = malloc(num_regexps * sizeof(struct DFATable*));
+        int* ids = malloc(num_regexps * sizeof(int));
+        for (int i = 0; i < num_regexps; i++) {
+            dfas[i] = entry[i] >= 0 ? cache->dfas[entry[i]] : jobs.results[-1 - entry[i]];
+            ids[i] = rule_ids ? rule_ids[i] : i;
+        }
+        dfa = product_construction(dfas, ids, num_regexps, memo, max_states, max_memory, dfa_accepting_rules);
+        free(dfas);
+        free(ids);
+    }
+
+    for (int i = 0; i < num_regexps; i++) free(keys[i]);
+    free(keys);
+    free(lens);
+    free(hashes);
+    free(entry);
+    free(missing);
+    free(missing_rule);
+    free(jobs.results);
+    cache_evict(cache);
+    return dfa;
+}
@@ -0,0 +1,58 @@
+#ifndef RULE_DFA_H_INCLUDED
+#define RULE_DFA_H_INCLUDED
+
+#include <stddef.h>
+#include "lang.h"
+#include "dfa_table.h"
+
+// 逐规则编译：每条规则单独确定化成一张稠密表，按规则的规范形式缓存，不同规则集共用的规则只编译一次；
+// 再用乘积构造把各规则的 DFA 合成词法分析器的 DFA，接受规则取元组中接受的最大规则编号，与 nfa_to_dfa 一致。
+// 缓存的表总大小超过 max_memory 时，每次构造结束后按最近一次使用的先后淘汰，本次构造用到的表不淘汰
+#define RULE_DFA_CACHE_DEFAULT_MAX_MEMORY ((size_t)256 << 20)
+
+struct RuleDFACache {
+    int count;
+    int cap;
+    char** keys;             /* canonical_regexp of every cached rule */
+    size_t* key_lens;
+    unsigned int* hashes;
+    struct DFATable** dfas;  /* accept[s] is 0 in accepting states and -1 elsewhere */
+    unsigned long long* last_used; /* value of builds when the entry was last looked up or inserted */
+    int* slots;              /* open addressing over cache entries, -1 for empty */
+    int num_slots;
+    size_t memory;           /* dfa_table_memory of all cached tables */
+    size_t max_memory;       /* eviction threshold, RULE_DFA_CACHE_DEFAULT_MAX_MEMORY unless changed by the caller */
+    unsigned long long builds;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+};
+
+// 乘积构造的备忘：上一次构造的乘积状态（(规则稳定编号, 状态) 对的元组）与各自的 256 项转移行。
+// 规则集改动后重建时，元组不涉及改动规则的状态直接沿用旧的转移行；稳定编号必须在规则改动时换新
+struct ProductMemo {
+    int** tuples;
+    int* lens;
+    int count;           /* 0 when empty or when the last product exceeded LEXER_DENSE_TABLE_MAX_STATES */
+    int* slots;
+    int num_slots;
+    int* rows;           /* count x 256 successor states, -1 for none */
+    int reused;          /* states of the last build whose rows came from the memo */
+};
+
+// 规则的规范字节串：字符集合按位图写出，与字符的书写顺序和重复无关；*len 为字节数
+char* canonical_regexp(struct frontend_regexp* fr, size_t* len);
+
+struct RuleDFACache* create_rule_dfa_cache(void);
+void free_rule_dfa_cache(struct RuleDFACache* cache);
+struct DFATable* compile_rule_dfa(struct frontend_regexp* fr, int max_states, size_t max_memory); /* NULL if over budget */
+struct ProductMemo* create_product_memo(void);
+void free_product_memo(struct ProductMemo* memo);
+
+// 缺失的规则在 num_threads 个线程里编译并放入 cache，然后做乘积构造；任何一步超出预算返回 NULL。
+// rule_ids 为 NULL 时以规则下标为编号；memo 非 NULL 时先复用其中的状态，成功后换成本次的状态
+struct finite_automata* build_product_dfa(struct frontend_regexp** regexps, int num_regexps, struct RuleDFACache* cache, int num_threads,
+                                          const int* rule_ids, struct ProductMemo* memo, int max_states, size_t max_memory,
+                                          int** dfa_accepting_rules);
+
+#endif // RULE_DFA_H_INCLUDED
@@ -0,0 +1,405 @@
+#include "search.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 搜索分两步：
+// 1. 非锚定 DFA（合并 NFA 的起点加上对所有字节的自环，相当于 .* 前缀）线性扫描，
+//    找到最早有规则接受的位置 e；扫描中回到起始状态的位置 lo 之前不可能有存活的匹配起点。
+// 2. 从 lo 起让锚定 DFA 同时从 [lo, e) 的每个候选起点运行，同一状态只保留起点最小的线程，
+//    一遍得到最左最长匹配，报告后从其末尾继续。绝大多数不匹配的字节只经过第 1 步的一次查表。
+//    一个起点更靠左、但最终不匹配的长前缀会让第 2 步一直运行到它失败为止，这部分代价与最左最长的语义相关，无法省去。
+
+// ==================== 前置过滤分析 ====================
+// 对每条规则的简化正则求一组字面量前缀：每个匹配都以其中之一开头。
+// complete 表示这些字符串本身就是全部匹配（语言有限），此时连接可以继续向后延伸。
+#define LITERAL_WORK_MAX 256
+
+typedef struct {
+    int n;
+    int complete;
+    char s[LITERAL_WORK_MAX][PREFILTER_MAX_LITERAL_LEN];
+    int len[LITERAL_WORK_MAX];
+} LiteralSet;
+
+static LiteralSet* empty_literal_set(int complete) {
+    LiteralSet* set = malloc(sizeof(LiteralSet));
+    set->n = 1;
+    set->len[0] = 0;
+    set->complete = complete;
+    return set;
+}
+
+static void dedupe_literals(LiteralSet* set) {
+    int kept = 0;
+    for (int i = 0; i < set->n; i++) {
+        int dup = 0;
+        for (int j = 0; j < kept && !dup; j++) {
+            dup = set->len[j] == set->len[i] && memcmp(set->s[j], set->s[i], set->len[i]) == 0;
+        }
+        if (dup) continue;
+        memmove(set->s[kept], set->s[i], set->len[i]);
+        set->len[kept] = set->len[i];
+        kept++;
+    }
+    set->n = kept;
+}
+
+// 集合过大时把最长的字符串截短一位再去重，直到不超过上限
+static void reduce_literals(LiteralSet* set) {
+    dedupe_literals(set);
+    while (set->n > PREFILTER_MAX_LITERALS) {
+        int longest = 0;
+        for (int i = 0; i < set->n; i++) {
+            if (set->len[i] > longest) longest = set->len[i];
+        }
+        for (int i = 0; i < set->n; i++) {
+            if (set->len[i] == longest) set->len[i]--;
+        }
+        set->complete = 0;
+        dedupe_literals(set);
+    }
+}
+
+static LiteralSet* literal_prefixes(struct simpl_regexp* sr) {
+    if (!sr) return empty_literal_set(1);
+    switch (sr->t) {
+        case T_S_EMPTY_STR:
+            return empty_literal_set(1);
+        case T_S_CHAR_SET: {
+            if (sr->d.CHAR_SET.n == 0) return empty_literal_set(1);
+            LiteralSet* set = malloc(sizeof(LiteralSet));
+            set->n = 0;
+            set->complete = 1;
+            for (unsigned int i = 0; i < sr->d.CHAR_SET.n && set->n < LITERAL_WORK_MAX; i++) {
+                set->s[set->n][0] = sr->d.CHAR_SET.c[i];
+                set->len[set->n] = 1;
+                set->n++;
+            }
+            reduce_literals(set);
+            return set;
+        }
+        case T_S_STAR:
+            return empty_literal_set(0);
+        case T_S_UNION: {
+            LiteralSet* a = literal_prefixes(sr->d.UNION.r1);
+            LiteralSet* b = literal_prefixes(sr->d.UNION.r2);
+            for (int i = 0; i < b->n && a->n < LITERAL_WORK_MAX; i++) {
+                memcpy(a->s[a->n], b->s[i], b->len[i]);
+                a->len[a->n] = b->len[i];
+                a->n++;
+            }
+            a->complete = a->complete && b->complete;
+            free(b);
+            reduce_literals(a);
+            return a;
+        }
+        case T_S_CONCAT: {
+            LiteralSet* a = literal_prefixes(sr->d.CONCAT.r1);
+            if (!a->complete) return a;
+            LiteralSet* b = literal_prefixes(sr->d.CONCAT.r2);
+            if (a->n * b->n > LITERAL_WORK_MAX) {
+                a->complete = 0;
+                free(b);
+                return a;
+            }
+            LiteralSet* out = malloc(sizeof(LiteralSet));
+            out->n = 0;
+            out->complete = b->complete;
+            for (int i = 0; i < a->n; i++) {
+                for (int j = 0; j < b->n; j++) {
+                    int len = a->len[i] + b->len[j];
+                    if (len > PREFILTER_MAX_LITERAL_LEN) {
+                        len = PREFILTER_MAX_LITERAL_LEN;
+                        out->complete = 0;
+                    }
+                    memcpy(out->s[out->n], a->s[i], a->len[i]);
+                    memcpy(out->s[out->n] + a->len[i], b->s[j], len - a->len[i]);
+                    out->len[out->n] = len;
+                    out->n++;
+                }
+            }
+            free(a);
+            free(b);
+            reduce_literals(out);
+            return out;
+        }
+    }
+    return empty_literal_set(0);
+}
+
+static int add_unique_byte(unsigned char* bytes, int n, unsigned char c) {
+    for (int i = 0; i < n; i++) {
+        if (bytes[i] == c) return n;
+    }
+    bytes[n] = c;
+    return n + 1;
+}
+
+void build_prefilter(struct LexPrefilter* pf, struct simpl_regexp** rules, int num_rules, struct DFATable* anchored) {
+    memset(pf, 0, sizeof(*pf));
+    // 所有规则的字面量前缀取并集
+    LiteralSet* all = malloc(sizeof(LiteralSet));
+    all->n = 0;
+    all->complete = 0;
+    for (int r = 0; r < num_rules; r++) {
+        LiteralSet* set = literal_prefixes(rules[r]);
+        for (int i = 0; i < set->n && all->n < LITERAL_WORK_MAX; i++) {
+            memcpy(all->s[all->n], set->s[i], set->len[i]);
+            all->len[all->n] = set->len[i];
+            all->n++;
+        }
+        free(set);
+        reduce_literals(all);
+    }
+    int min_len = all->n > 0 ? PREFILTER_MAX_LITERAL_LEN : 0, max_len = 0;
+    for (int i = 0; i < all->n; i++) {
+        if (all->len[i] < min_len) min_len = all->len[i];
+        if (all->len[i] > max_len) max_len = all->len[i];
+    }
+
+    if (min_len >= 1) {
+        for (int i = 0; i < all->n; i++) {
+            pf->num_bytes = add_unique_byte(pf->bytes, pf->num_bytes, (unsigned char)all->s[i][0]);
+            if (min_len >= 2) pf->num_second = add_unique_byte(pf->second, pf->num_second, (unsigned char)all->s[i][1]);
+            memcpy(pf->literals[i], all->s[i], all->len[i]);
+            pf->literal_len[i] = all->len[i];
+        }
+        pf->num_literals = all->n;
+        pf->kind = max_len >= 2 ? PREFILTER_LITERALS : PREFILTER_BYTESET;
+    } else {
+        // 没有可用的字面量时，退而使用 DFA 起始状态的首字节集合
+        int count = 0;
+        for (int c = 0; c < 256; c++) {
+            if (anchored->next[c] == -1) continue;
+            if (count < PREFILTER_MAX_BYTES) pf->bytes[count] = (unsigned char)c;
+            count++;
+        }
+        pf->num_bytes = count;
+        pf->kind = count > PREFILTER_MAX_BYTES ? PREFILTER_NONE : PREFILTER_BYTESET;
+    }
+    if (pf->kind == PREFILTER_BYTESET && pf->num_bytes == 1) pf->kind = PREFILTER_MEMCHR;
+    free(all);
+}
+
+static int verify_literals(struct LexPrefilter* pf, const char* buf, int pos, int len) {
+    for (int i = 0; i < pf->num_literals; i++) {
+        int l = pf->literal_len[i];
+        if (pos + l <= len && memcmp(buf + pos, pf->literals[i], l) == 0) return 1;
+    }
+    return 0;
+}
+
+static int byte_in(const unsigned char* bytes, int n, unsigned char c) {
+    for (int i = 0; i < n; i++) {
+        if (bytes[i] == c) return 1;
+    }
+    return 0;
+}
+
+int prefilter_next_candidate(struct LexPrefilter* pf, const char* buf, int from, int len) {
+    if (from >= len) return -1;
+    if (pf->kind == PREFILTER_NONE) return from;
+    if (pf->kind == PREFILTER_MEMCHR) {
+        const char* hit = memchr(buf + from, pf->bytes[0], len - from);
+        return hit ? (int)(hit - buf) : -1;
+    }
+    int literals = pf->kind == PREFILTER_LITERALS;
+    int i = from;
+#if defined(__SSE2__)
+    // 每次比较 16 个字节：首字节落在集合中，且（有字面量时）下一个字节也可能是第二个字节
+    __m128i first[PREFILTER_MAX_BYTES], second[PREFILTER_MAX_BYTES];
+    for (int k = 0; k < pf->num_bytes; k++) first[k] = _mm_set1_epi8((char)pf->bytes[k]);
+    for (int k = 0; k < pf->num_second; k++) second[k] = _mm_set1_epi8((char)pf->second[k]);
+    for (; i + 17 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(buf + i));
+        __m128i hit = _mm_setzero_si128();
+        for (int k = 0; k < pf->num_bytes; k++) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, first[k]));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(hit);
+        if (mask && pf->num_second > 0) {
+            __m128i next = _mm_loadu_si128((const __m128i*)(buf + i + 1));
+            __m128i hit2 = _mm_setzero_si128();
+            for (int k = 0; k < pf->num_second; k++) hit2 = _mm_or_si128(hit2, _mm_cmpeq_epi8(next, second[k]));
+            mask &= (unsigned int)_mm_movemask_epi8(hit2);
+        }
+        while (mask) {
+            int pos = i + __builtin_ctz(mask);
+            if (!literals || verify_literals(pf, buf, pos, len)) return pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if (!byte_in(pf->bytes, pf->num_bytes, (unsigned char)buf[i])) continue;
+        if (!literals || verify_literals(pf, buf, i, len)) return i;
+    }
+    return -1;
+}
+
+struct LexSearcher* build_searcher(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options) {
+    int max_states = (options && options->max_dfa_states) ? options->max_dfa_states : LEXER_DEFAULT_MAX_DFA_STATES;
+    size_t max_memory = (options && options->max_dfa_memory) ? options->max_dfa_memory : LEXER_DEFAULT_MAX_DFA_MEMORY;
+    int* accepting_states;
+    int num_accepting;
+    struct finite_automata* nfa = build_combined_nfa(regexps, num_regexps, &accepting_states, &num_accepting);
+    if (!nfa) return NULL;
+
+    int* rules;
+    struct finite_automata* dfa = nfa_to_dfa_bounded(nfa, accepting_states, num_accepting, &rules, max_states, max_memory);
+    if (!dfa) {
+        free_finite_automata(nfa);
+        free(accepting_states);
+        return NULL;
+    }
+    struct LexSearcher* searcher = malloc(sizeof(struct LexSearcher));
+    searcher->anchored = build_dfa_table(dfa, rules);
+    searcher->unanchored = NULL;
+    free_finite_automata(dfa);
+    free(rules);
+
+    struct simpl_regexp** simplified = malloc((num_regexps + 1) * sizeof(struct simpl_regexp*));
+    for (int i = 0; i < num_regexps; i++) simplified[i] = simplify_regexp(regexps[i]);
+    build_prefilter(&searcher->prefilter, simplified, num_regexps, searcher->anchored);
+    free(simplified);
+
+    // .* 前缀：起点在任意字节上回到自身
+    char all_bytes[256];
+    for (int c = 0; c < 256; c++) all_bytes[c] = (char)c;
+    struct char_set any = { all_bytes, 256 };
+    add_one_edge(nfa, 0, 0, &any);
+    dfa = nfa_to_dfa_bounded(nfa, accepting_states, num_accepting, &rules, max_states, max_memory);
+    if (dfa) {
+        searcher->unanchored = build_dfa_table(dfa, rules);
+        free_finite_automata(dfa);
+        free(rules);
+    }
+    free_finite_automata(nfa);
+    free(accepting_states);
+    return searcher;
+}
+
+// 第 2 步的暂存区：每个锚定 DFA 状态上至多保留一个线程
+typedef struct {
+    int* states;
+    int* starts;
+    int* next_states;
+    int* next_starts;
+    int* mark;   /* mark[s] == stamp: state s already holds a thread in the current list */
+    int stamp;
+} MatchThreads;
+
+// 从 lo 起把锚定 DFA 同时从每个候选起点运行：线程按起点从小到大排列，落到同一状态的线程以后走法完全相同，
+// 只留起点最小的一个，所以每个字节的代价不超过状态数，不必对每个起点各自扫描一遍。
+// 起点只在 [lo, add_end) 中添加；一旦有线程接受，起点更大的线程就不可能是最左的匹配，全部丢弃，
+// 剩下起点更小的线程继续运行到死亡或输入末尾，决定最终的最左最长匹配。找到时返回 1
+static int leftmost_longest(struct LexSearcher* searcher, MatchThreads* mt, const char* buf, int len, int lo, int add_end, LexToken* match) {
+    struct DFATable* t = searcher->anchored;
+    int n = 0, best_start = -1, best_len = 0, best_rule = -1;
+    int candidate = prefilter_next_candidate(&searcher->prefilter, buf, lo, len);
+    mt->stamp++;
+    for (int i = lo; ; i++) {
+        if (best_start == -1 && candidate == i && i < add_end) {
+            if (mt->mark[0] != mt->stamp) {
+                mt->mark[0] = mt->stamp;
+                mt->states[n] = 0;
+                mt->starts[n] = i;
+                n++;
+            }
+            candidate = prefilter_next_candidate(&searcher->prefilter, buf, i + 1, len);
+        }
+        if (n == 0) {
+            // 没有存活的线程时直接跳到下一个候选起点
+            if (best_start != -1 || candidate < 0 || candidate >= add_end) break;
+            i = candidate - 1;
+            continue;
+        }
+        if (i == len) break;
+        unsigned char c = (unsigned char)buf[i];
+        int m = 0;
+        mt->stamp++;
+        for (int k = 0; k < n; k++) {
+            int start = mt->starts[k];
+            if (best_start != -1 && start > best_start) break;
+            int s = t->next[(size_t)mt->states[k] * 256 + c];
+            if (s < 0 || mt->mark[s] == mt->stamp) continue;
+            mt->mark[s] = mt->stamp;
+            if (t->accept[s] != -1 && (best_start == -1 || start <= best_start)) {
+                best_start = start;
+                best_len = i + 1 - start;
+                best_rule = t->accept[s];
+            }
+            mt->next_states[m] = s;
+            mt->next_starts[m] = start;
+            m++;
+        }
+        int* tmp = mt->states;
+        mt->states = mt->next_states;
+        mt->next_states = tmp;
+        tmp = mt->starts;
+        mt->starts = mt->next_starts;
+        mt->next_starts = tmp;
+        n = m;
+    }
+    if (best_start == -1) return 0;
+    match->offset = best_start;
+    match->length = best_len;
+    match->rule = best_rule;
+    return 1;
+}
+
+int lex_search(struct LexSearcher* searcher, const char* buf, int len, LexToken* matches, int max_matches) {
+    struct DFATable* u = searcher->unanchored;
+    int num_states = searcher->anchored->num_states;
+    MatchThreads mt;
+    int* scratch = malloc(4 * (size_t)num_states * sizeof(int));
+    mt.states = scratch;
+    mt.starts = mt.states + num_states;
+    mt.next_states = mt.starts + num_states;
+    mt.next_starts = mt.next_states + num_states;
+    mt.mark = calloc(num_states, sizeof(int));
+    mt.stamp = 0;
+    int count = 0, pos = 0;
+    while (pos < len && count < max_matches) {
+        int lo = pos, end = -1;
+        if (u) {
+            // 第 1 步：找最早的匹配结束位置；处于起始状态时用前置过滤跳到下一个候选位置
+            int state = 0;
+            for (int i = pos; i < len; i++) {
+                if (state == 0) {
+                    i = prefilter_next_candidate(&searcher->prefilter, buf, i, len);
+                    if (i < 0) break;
+                    lo = i;
+                }
+                state = u->next[(size_t)state * 256 + (unsigned char)buf[i]];
+                if (state == 0) lo = i + 1;
+                if (u->accept[state] != -1) {
+                    end = i + 1;
+                    break;
+                }
+            }
+            if (end == -1) break;
+        } else {
+            // 非锚定 DFA 超出预算：第 2 步直接从 pos 开始，起点可以一直添加到输入末尾
+            end = len;
+        }
+        // 第 2 步：最左的非空最长匹配
+        if (leftmost_longest(searcher, &mt, buf, len, lo, end, &matches[count])) {
+            pos = matches[count].offset + matches[count].length;
+            count++;
+        } else {
+            pos = end > pos ? end : pos + 1;
+        }
+    }
+    free(scratch);
+    free(mt.mark);
+    return count;
+}
+
+void free_searcher(struct LexSearcher* searcher) {
+    if (!searcher) return;
+    free_dfa_table(searcher->anchored);
+    free_dfa_table(searcher->unanchored);
+    free(searcher);
+}
@@ -0,0 +1,45 @@
+#ifndef SEARCH_H_INCLUDED
+#define SEARCH_H_INCLUDED
+
+#include "lexer.h"
+#include "dfa_table.h"
+
+// 多模式搜索：与 lexical_analysis 不同，不要求从 0 开始覆盖整个输入，
+// 而是像 grep 一样在缓冲区任意位置找出所有规则的匹配
+// 前置过滤：匹配只可能从首字节集合中的字节、或从某个必需的字面量前缀开始，
+// 其余位置用 memchr / SIMD 直接跳过，不必逐字节运行 DFA
+#define PREFILTER_MAX_BYTES 16
+#define PREFILTER_MAX_LITERALS 16
+#define PREFILTER_MAX_LITERAL_LEN 8
+
+enum PrefilterKind {
+    PREFILTER_NONE = 0,  /* too many possible first bytes, scan with the DFA */
+    PREFILTER_MEMCHR,    /* a single possible first byte */
+    PREFILTER_BYTESET,   /* at most PREFILTER_MAX_BYTES possible first bytes */
+    PREFILTER_LITERALS   /* every match starts with one of a few literals */
+};
+
+struct LexPrefilter {
+    enum PrefilterKind kind;
+    int num_bytes;
+    unsigned char bytes[PREFILTER_MAX_BYTES];       /* possible first bytes */
+    unsigned char second[PREFILTER_MAX_BYTES];      /* possible second bytes when every literal has two or more */
+    int num_second;
+    int num_literals;
+    char literals[PREFILTER_MAX_LITERALS][PREFILTER_MAX_LITERAL_LEN];
+    int literal_len[PREFILTER_MAX_LITERALS];
+};
+
+struct LexSearcher {
+    struct DFATable* anchored;   /* the tokenizer DFA, used to confirm the leftmost-longest match */
+    struct DFATable* unanchored; /* same rules behind a .* prefix, or NULL when it exceeded the budget */
+    struct LexPrefilter prefilter;
+};
+
+struct LexSearcher* build_searcher(struct frontend_regexp** regexps, int num_regexps, struct LexerOptions* options); /* NULL if the anchored DFA exceeds the budget */
+int lex_search(struct LexSearcher* searcher, const char* buf, int len, LexToken* matches, int max_matches); /* return the number of matches written */
+void free_searcher(struct LexSearcher* searcher);
+void build_prefilter(struct LexPrefilter* pf, struct simpl_regexp** rules, int num_rules, struct DFATable* anchored);
+int prefilter_next_candidate(struct LexPrefilter* pf, const char* buf, int from, int len); /* first candidate position >= from, or -1 */
+
+#endif // SEARCH_H_INCLUDED
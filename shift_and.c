@@ -0,0 +1,163 @@
+#include "shift_and.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Glushkov 构造：每个字符集叶子是一个位置，
+// 对每个子表达式求 nullable / first / last，并在连接与星号处补上 follow 边
+typedef struct {
+    int nullable;
+    uint64_t first;
+    uint64_t last;
+} GlushkovInfo;
+
+typedef struct {
+    struct ShiftAndLexer* sa;
+    uint64_t follow[SHIFT_AND_MAX_POSITIONS];
+    int overflow;
+} GlushkovBuilder;
+
+static void add_follow(GlushkovBuilder* b, uint64_t from, uint64_t to) {
+    for (int p = 0; p < b->sa->num_positions; p++) {
+        if ((from >> p) & 1) b->follow[p] |= to;
+    }
+}
+
+static GlushkovInfo glushkov(GlushkovBuilder* b, struct simpl_regexp* sr) {
+    GlushkovInfo info = {1, 0, 0};
+    if (!sr || b->overflow) return info;
+    switch (sr->t) {
+        case T_S_CHAR_SET: {
+            // 空字符集在 NFA 里是一条 ε 边，这里同样当作空串
+            if (sr->d.CHAR_SET.n == 0) break;
+            if (b->sa->num_positions == SHIFT_AND_MAX_POSITIONS) {
+                b->overflow = 1;
+                break;
+            }
+            int p = b->sa->num_positions++;
+            for (unsigned int i = 0; i < sr->d.CHAR_SET.n; i++) {
+                b->sa->char_masks[(unsigned char)sr->d.CHAR_SET.c[i]] |= (uint64_t)1 << p;
+            }
+            info.nullable = 0;
+            info.first = info.last = (uint64_t)1 << p;
+            break;
+        }
+        case T_S_EMPTY_STR:
+            break;
+        case T_S_STAR: {
+            GlushkovInfo r = glushkov(b, sr->d.STAR.r);
+            add_follow(b, r.last, r.first);
+            info.first = r.first;
+            info.last = r.last;
+            break;
+        }
+        case T_S_UNION: {
+            GlushkovInfo r1 = glushkov(b, sr->d.UNION.r1);
+            GlushkovInfo r2 = glushkov(b, sr->d.UNION.r2);
+            info.nullable = r1.nullable || r2.nullable;
+            info.first = r1.first | r2.first;
+            info.last = r1.last | r2.last;
+            break;
+        }
+        case T_S_CONCAT: {
+            GlushkovInfo r1 = glushkov(b, sr->d.CONCAT.r1);
+            GlushkovInfo r2 = glushkov(b, sr->d.CONCAT.r2);
+            add_follow(b, r1.last, r2.first);
+            info.nullable = r1.nullable && r2.nullable;
+            info.first = r1.first | (r1.nullable ? r2.first : 0);
+            info.last = r2.last | (r2.nullable ? r1.last : 0);
+            break;
+        }
+    }
+    return info;
+}
+
+struct ShiftAndLexer* build_shift_and(struct simpl_regexp** rules, int num_rules) {
+    GlushkovBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.sa = calloc(1, sizeof(struct ShiftAndLexer));
+    b.sa->num_rules = num_rules;
+    b.sa->accept_masks = calloc(num_rules + 1, sizeof(uint64_t));
+    b.sa->empty_rule = -1;
+    for (int r = 0; r < num_rules && !b.overflow; r++) {
+        GlushkovInfo info = glushkov(&b, rules[r]);
+        b.sa->init |= info.first;
+        b.sa->accept_masks[r] = info.last;
+        b.sa->accept_any |= info.last;
+        // 与 DFA 一致：同时接受时编号靠后的规则胜出
+        if (info.nullable) b.sa->empty_rule = r;
+    }
+    if (b.overflow) {
+        free_shift_and(b.sa);
+        return NULL;
+    }
+    // 把 follow 拆成 p -> p + 1 的移位、p -> p 的自环和其余的例外边
+    for (int p = 0; p < b.sa->num_positions; p++) {
+        uint64_t f = b.follow[p];
+        uint64_t next_bit = (p + 1 < SHIFT_AND_MAX_POSITIONS) ? (uint64_t)1 << (p + 1) : 0;
+        uint64_t self_bit = (uint64_t)1 << p;
+        if (f & next_bit) b.sa->shift_mask |= self_bit;
+        if (f & self_bit) b.sa->self_mask |= self_bit;
+        b.sa->follow_rest[p] = f & ~(next_bit | self_bit);
+        if (b.sa->follow_rest[p]) b.sa->exception_mask |= self_bit;
+    }
+    return b.sa;
+}
+
+static inline uint64_t follow_of(struct ShiftAndLexer* sa, uint64_t d) {
+    uint64_t f = ((d & sa->shift_mask) << 1) | (d & sa->self_mask);
+    uint64_t ex = d & sa->exception_mask;
+    while (ex) {
+        int p = __builtin_ctzll(ex);
+        f |= sa->follow_rest[p];
+        ex &= ex - 1;
+    }
+    return f;
+}
+
+static inline int accepting_rule(struct ShiftAndLexer* sa, uint64_t d, int at_start) {
+    if (at_start) return sa->empty_rule;
+    if (!(d & sa->accept_any)) return -1;
+    for (int r = sa->num_rules - 1; r >= 0; r--) {
+        if (d & sa->accept_masks[r]) return r;
+    }
+    return -1;
+}
+
+static inline void shift_and_reset(void* ctx) {
+    struct ShiftAndCursor* cur = ctx;
+    cur->d = 0;
+    cur->at_start = 1;
+}
+
+static inline int shift_and_step(void* ctx, unsigned char c) {
+    struct ShiftAndCursor* cur = ctx;
+    struct ShiftAndLexer* sa = cur->sa;
+    uint64_t start_mask = (uint64_t)0 - (uint64_t)cur->at_start;
+    uint64_t next = (follow_of(sa, cur->d) | (sa->init & start_mask)) & sa->char_masks[c];
+    if (next == 0) return 0;
+    cur->d = next;
+    cur->at_start = 0;
+    return 1;
+}
+
+static inline int shift_and_accept(void* ctx) {
+    struct ShiftAndCursor* cur = ctx;
+    return accepting_rule(cur->sa, cur->d, cur->at_start);
+}
+
+static const LexMunchOps shift_and_ops = { shift_and_reset, shift_and_step, shift_and_accept };
+
+int shift_and_munch(struct ShiftAndCursor* cur, struct LexMunch* m, const char* input, int len, int eof) {
+    return lex_munch(&shift_and_ops, cur, m, (const unsigned char*)input, len, eof);
+}
+
+void shift_and_lexical_analysis(struct ShiftAndLexer* sa, char* input, int* segments, int* categories) {
+    struct ShiftAndCursor cur = { sa, 0, 1 };
+    lex_munch_segments(&shift_and_ops, &cur, input, strlen(input), segments, categories);
+}
+
+void free_shift_and(struct ShiftAndLexer* sa) {
+    if (!sa) return;
+    free(sa->accept_masks);
+    free(sa);
+}
@@ -0,0 +1,38 @@
+#ifndef SHIFT_AND_H_INCLUDED
+#define SHIFT_AND_H_INCLUDED
+
+#include "lang.h"
+#include "lexer_munch.h"
+#include <stdint.h>
+
+// 位并行（Shift-And）引擎：所有规则的 Glushkov 位置自动机合起来不超过 64 个位置时，
+// 活跃位置集合放进一个 64 位字，每读一个字节只需几次移位 / 与 / 或运算
+#define SHIFT_AND_MAX_POSITIONS 64
+
+struct ShiftAndLexer {
+    int num_positions;
+    int num_rules;
+    uint64_t char_masks[256];   /* for every byte c, the positions whose char set contains c */
+    uint64_t init;              /* positions that can be the first one of a token */
+    uint64_t shift_mask;        /* positions p whose follow set contains p + 1 */
+    uint64_t self_mask;         /* positions p whose follow set contains p */
+    uint64_t exception_mask;    /* positions p with other follow edges, kept in follow_rest[p] */
+    uint64_t follow_rest[SHIFT_AND_MAX_POSITIONS];
+    uint64_t accept_any;
+    uint64_t* accept_masks;     /* for every rule r, the positions that may end a match of r */
+    int empty_rule;             /* rule accepted by the empty prefix, or -1 */
+};
+
+// lexer_munch.h 驱动用的游标，DFA 状态换成活跃位置集合 d；at_start 表示这个单元还没读入字节
+struct ShiftAndCursor {
+    struct ShiftAndLexer* sa;
+    uint64_t d;
+    int at_start;
+};
+
+struct ShiftAndLexer* build_shift_and(struct simpl_regexp** rules, int num_rules); /* NULL if the rules need more than 64 positions */
+void shift_and_lexical_analysis(struct ShiftAndLexer* sa, char* input, int* segments, int* categories);
+int shift_and_munch(struct ShiftAndCursor* cur, struct LexMunch* m, const char* input, int len, int eof); /* lex_munch on this engine */
+void free_shift_and(struct ShiftAndLexer* sa);
+
+#endif // SHIFT_AND_H_INCLUDED